@@ -0,0 +1,31 @@
+#ifndef SRC_ASSIGNMENT_HPP_
+#define SRC_ASSIGNMENT_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#define INFEASIBLE_COST 		1e9				//Cost of a pair that can not be assigned
+
+/* Uniform grid over the frame, to find the points close to a position without scanning all of them */
+class SpatialGrid {
+
+	private:
+		float 				cellSize_;		//Side of a cell (pixels)
+		int 				cols_, rows_;	//Number of cells
+		std::vector<int> 	cellStart_;		//Position in points_ of the first point of each cell
+		std::vector<int> 	points_;		//Indices of the points, sorted by cell
+
+	public:
+		SpatialGrid() : cellSize_(1), cols_(0), rows_(0) {}
+
+		void build(const std::vector<cv::Point2f> &points, cv::Size area, float cellSize);
+
+		void query(cv::Point2f center, std::vector<int> &result) const;
+
+	private:
+		int cellOf(float coordinate, int cells) const;
+};
+
+std::vector<int> solveAssignment(const std::vector<double> &cost, int rows, int cols);
+
+#endif /* SRC_ASSIGNMENT_HPP_ */
@@ -0,0 +1,57 @@
+#ifndef SRC_BLOBDETECTOR_HPP_
+#define SRC_BLOBDETECTOR_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+#define BLOB_STRIPE_ROWS 		64				//Rows of the mask labeled by the same task
+
+/* Region of 8-connected foreground pixels */
+struct ForegroundBlob {
+	cv::Rect 	box;		//Bounding box
+	int 		area;		//Number of pixels
+	cv::Point2f centroid;	//Mean position of the pixels
+};
+
+/* Horizontal segment of foreground pixels, in a single row */
+struct BlobRun {
+	int y;			//Row
+	int start;		//First column
+	int end;		//Column after the last one
+};
+
+/* Connected components of a foreground mask, with their bounding boxes, areas and centroids, found in a single pass.
+ * The mask is split in horizontal stripes, labeled in parallel: each stripe turns its rows into runs of foreground pixels
+ * and joins the runs that touch the ones of the row above. Then the runs across the borders of the stripes are joined,
+ * and the statistics of each component are summed over its runs. No image of labels is written, and all the buffers
+ * are kept from one frame to the next.
+ * Like the external contours of findContours, components inside a hole of another component are left out */
+class BlobDetector {
+
+	private:
+		std::vector< std::vector<BlobRun> > stripeRuns_;	//Runs of each stripe
+		std::vector< std::vector<int> > 	stripeParents_;	//Union-find parents of the runs of each stripe, local to the stripe
+		std::vector<int> 					parents_;		//Union-find parents of all the runs
+		std::vector<int> 					labels_;		//Component of each root run
+		std::vector<int64_t> 				sums_;			//Sum of the columns and of the rows of each component
+		std::vector<int> 					leftRows_;		//A row where each component reaches its leftmost column
+		std::vector<int> 					order_;			//Components sorted by their leftmost column
+		std::vector<uint8_t> 				visited_;		//Background pixels reached by a flood fill
+		std::vector<int> 					queue_;			//Background pixels to visit in a flood fill
+		std::vector<ForegroundBlob> 			blobs_;			//Components of the last mask
+
+	public:
+		const std::vector<ForegroundBlob> &detect(const cv::Mat &mask, cv::Point offset = cv::Point());
+
+	private:
+		void labelStripe(const cv::Mat &mask, int stripe, int firstRow, int lastRow);
+
+		bool enclosed(const cv::Mat &mask, cv::Point start, cv::Rect bounds);
+
+		void removeNested(const cv::Mat &mask, std::vector<ForegroundBlob> &blobs);
+
+		friend class StripeLabeling;
+};
+
+#endif /* SRC_BLOBDETECTOR_HPP_ */
@@ -0,0 +1,79 @@
+#ifndef SRC_BOUNDEDQUEUE_HPP_
+#define SRC_BOUNDEDQUEUE_HPP_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/* FIFO queue with a fixed capacity, used to connect the stages of the pipeline.
+ * A producer blocks while the queue is full (backpressure), a consumer blocks while it is empty.
+ * Once closed, pushes are refused and pops drain the remaining items. */
+template <typename T>
+class BoundedQueue {
+
+	private:
+		std::deque<T> 				queue_;			//Items waiting to be consumed
+		size_t 						capacity_;		//Maximum number of items in the queue
+		bool 						closed_;		//No more items will be accepted
+		std::mutex 					mutex_;
+		std::condition_variable 	notFull_;
+		std::condition_variable 	notEmpty_;
+
+	public:
+		explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1), closed_(false) {}
+
+		/* Append an item, waiting for a free slot. Return false if the queue has been closed */
+		bool push(T item){
+			std::unique_lock<std::mutex> lock(mutex_);
+			notFull_.wait(lock, [this]{ return closed_ || queue_.size() < capacity_; });
+			if(closed_)
+				return false;
+			queue_.push_back(std::move(item));
+			notEmpty_.notify_one();
+			return true;
+		}
+
+		/* Remove the oldest item, waiting for one to be available. Return false if the queue is closed and empty */
+		bool pop(T &item){
+			std::unique_lock<std::mutex> lock(mutex_);
+			notEmpty_.wait(lock, [this]{ return closed_ || !queue_.empty(); });
+			if(queue_.empty())
+				return false;
+			item = std::move(queue_.front());
+			queue_.pop_front();
+			notFull_.notify_one();
+			return true;
+		}
+
+		/* Remove the oldest item if there is one, without waiting. Return false if the queue is empty */
+		bool tryPop(T &item){
+			std::lock_guard<std::mutex> lock(mutex_);
+			if(queue_.empty())
+				return false;
+			item = std::move(queue_.front());
+			queue_.pop_front();
+			notFull_.notify_one();
+			return true;
+		}
+
+		/* Whether the queue is closed and all its items have been consumed */
+		bool drained(){
+			std::lock_guard<std::mutex> lock(mutex_);
+			return closed_ && queue_.empty();
+		}
+
+		/* Refuse further items and wake up all the waiting threads */
+		void close(){
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+			notFull_.notify_all();
+			notEmpty_.notify_all();
+		}
+
+		size_t size(){
+			std::lock_guard<std::mutex> lock(mutex_);
+			return queue_.size();
+		}
+};
+
+#endif /* SRC_BOUNDEDQUEUE_HPP_ */
@@ -0,0 +1,44 @@
+#ifndef SRC_CAFFEENGINE_HPP_
+#define SRC_CAFFEENGINE_HPP_
+
+#define CPU_ONLY
+
+#include "../include/InferenceEngine.hpp"
+#include <caffe/caffe.hpp>
+
+/* Inference through Caffe. There is a net for each batch size, all sharing the weights of the first one:
+ * each net is reshaped once at load time, so a batch only pays for its forward pass */
+class CaffeEngine : public InferenceEngine {
+
+	private:
+		std::vector< caffe::shared_ptr<caffe::Net<float> > > nets_;	//The imported net, once per batch size
+		std::vector<int> 				sizes_;				//Batch size of each net
+		std::string 					model_file_;		//Prototxt of the net, to build the nets of the replicas
+
+	public:
+		CaffeEngine(const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes, bool use_GPU);
+
+		/* Replica of an engine: nets of the same batch sizes, sharing the weights of its nets */
+		explicit CaffeEngine(const CaffeEngine &source);
+
+		CaffeEngine& operator=(const CaffeEngine&) = delete;
+
+		int inputChannels() const;
+
+		cv::Size inputGeometry() const;
+
+		int outputSize() const;
+
+		float *input(int size);
+
+		const float *forward(int size);
+
+		std::unique_ptr<InferenceEngine> replicate() const;
+
+	private:
+		void shape();
+
+		caffe::Net<float> *net(int size) const;
+};
+
+#endif /* SRC_CAFFEENGINE_HPP_ */
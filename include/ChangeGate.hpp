@@ -0,0 +1,36 @@
+#ifndef SRC_CHANGEGATE_HPP_
+#define SRC_CHANGEGATE_HPP_
+
+#include <opencv2/opencv.hpp>
+
+#define CHANGE_SAMPLE_ROWS 		4				//One row of the mask out of these is counted
+#define CHANGE_RECOVERY_FRAMES 	5				//Frames the subtractor learns faster after a global change
+#define CHANGE_LEARNING_RATE 	0.2				//Learning rate of the subtractor in those frames
+
+/* Detection of global changes of the scene (lighting flashes, clouds, automatic exposure), which turn most of the
+ * foreground mask on at once. The fraction of foreground pixels is estimated on the raw mask, right after the
+ * subtraction, by counting the set bytes of a subsample of its rows eight at a time, so that a changed frame skips
+ * the morphology, the components and the classification. The tracks are not updated on such a frame, so they
+ * survive the change and keep their labels. After a change the subtractor learns at a raised rate for a few
+ * frames, so that its model takes the new lighting in a handful of frames instead of dozens */
+class ChangeGate {
+
+	private:
+		float 	threshold_;		//Fraction of foreground pixels over which the frame is a global change, 1 to never gate
+		int 	recovery_;		//Frames left at the raised learning rate
+		double 	learningRate_;	//Learning rate out of the recovery, negative for the subtractor's own
+
+	public:
+		explicit ChangeGate(float threshold = 1, double learningRate = -1);
+
+		/* Learning rate of the next subtraction: raised after a change, otherwise the configured one */
+		double learningRate() const { return recovery_ > 0 ? CHANGE_LEARNING_RATE : learningRate_; }
+
+		/* Whether the foreground mask of the frame is a global change */
+		bool changed(const cv::Mat &mask);
+
+		/* Fraction of the pixels of a 0/255 mask in the foreground, on one row out of CHANGE_SAMPLE_ROWS */
+		static float foregroundRatio(const cv::Mat &mask);
+};
+
+#endif /* SRC_CHANGEGATE_HPP_ */
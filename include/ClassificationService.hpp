@@ -0,0 +1,62 @@
+#ifndef SRC_CLASSIFICATIONSERVICE_HPP_
+#define SRC_CLASSIFICATIONSERVICE_HPP_
+
+#include "../include/Classifier.hpp"
+#include <deque>
+#include <future>
+#include <thread>
+#include <condition_variable>
+#include <stdexcept>
+
+typedef std::shared_future< vector<Prediction> > PendingPrediction;
+
+/* Asynchronous front end of the classifier. Images submitted by any thread are collected into a batch
+ * until either the batch is full or the oldest image has waited for the maximum time, then the whole
+ * batch goes through the network with a single forward pass. There is a worker for each replica of the network,
+ * so that a batch can be collected while the previous ones are still running */
+class ClassificationService {
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		/* An image waiting to be classified */
+		struct Request {
+			Mat 								image;		//Object to classify
+			Clock::time_point 					arrival;	//Submission time
+			std::promise< vector<Prediction> > 	result;		//Predictions of the image
+		};
+
+		Classifier &				classifier_;		//The network
+		int 						num_classes_;		//Number of possible objects classes
+		size_t 						max_batch_size_;	//Maximum number of images in a batch
+		Clock::duration 			max_wait_;			//Maximum time an image waits for the batch to fill
+		std::deque<Request> 		pending_;			//Images not yet classified
+		bool 						stopped_;			//No more images will be accepted
+		vector<long> 				batch_sizes_;		//Number of batches of each size
+		std::mutex 					mutex_;
+		std::condition_variable 	available_;
+		vector<std::thread> 		workers_;			//Run the batches
+		MetricProbe 				pendingProbe_;		//Exports the number of images pending
+
+	public:
+		ClassificationService(Classifier &classifier, int num_classes, int max_batch_size, double max_wait_ms);
+
+		~ClassificationService();
+
+		PendingPrediction submit(const Mat &image);
+
+		vector<PendingPrediction> submitBatch(const vector<Mat> &images);
+
+		vector< vector<Prediction> > classify(const vector<Mat> &images);
+
+		void stop();
+
+		vector<long> batchSizes();
+
+		void printStatistics(ostream &out);
+
+	private:
+		void run();
+};
+
+#endif /* SRC_CLASSIFICATIONSERVICE_HPP_ */
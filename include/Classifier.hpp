@@ -1,32 +1,43 @@
 #ifndef SRC_CLASSIFIER_HPP_
 #define SRC_CLASSIFIER_HPP_
 
-#define CPU_ONLY
-
 #include <opencv2/opencv.hpp>
-#include <caffe/caffe.hpp>
+#include "../include/Profiler.hpp"
+#include "../include/InferenceEngine.hpp"
+#include "../include/ModelBundle.hpp"
+#include <condition_variable>
+#include <mutex>
 
 using namespace std;
 using namespace cv;
-using namespace caffe;
 
 enum Classes
 	{car, person, bus, truck, van, motorbike, bicycle, tram, background, other};
 
 Classes strToEnum(string s);
+string  enumToStr(Classes c);
 
 /* Pair (label, confidence) representing a prediction. */
 typedef std::pair<string, float> Prediction;
 
+/* Classification of batches of images: preprocessing, forward pass through the inference engine of the selected
+ * backend and top predictions. The network can be replicated, the replicas sharing its weights: a batch is split
+ * among the replicas idle when it arrives, and batches classified at the same time by different threads run on
+ * different replicas */
 class Classifier {
 
 	private:
-		shared_ptr<caffe::Net<float> > 	net_;				//The imported net
+		std::unique_ptr<ModelBundle> 	bundle_;			//Bundle the network was loaded from, if any, outlives the engines
+		std::vector< std::unique_ptr<InferenceEngine> > engines_;	//Replicas of the network, the first one loaded from the files
+		std::vector<int> 				idle_;				//Replicas not running any batch
+		std::mutex 						replicaMutex_;		//Protects the idle replicas
+		std::condition_variable 		replicaReleased_;
+		std::vector<int> 				buckets_;			//Batch sizes the network is shaped for
 		cv::Size 						input_geometry_;	//Input layer width and height
 		int 							num_channels_;		//Input layer channels
-		cv::Mat 						mean_;				//Mean image
+		std::vector<float> 				mean_values_;		//Mean value of each channel
 		std::vector<string> 			labels_;			//Class labels
-		int 							batch_size_;		//Batch size
+		Profiler *						profiler_;			//Collects the time spent in each step, if any
 
 	public:
 		Classifier(const string& model_file,
@@ -34,24 +45,48 @@ class Classifier {
 					const string& mean_file,
 					const string& label_file,
 					const bool use_GPU,
-					const int batch_size);
+					const int max_batch_size,
+					const string& backend = "caffe",
+					const int replicas = 1);
+
+		Classifier(const string& bundle_file, const int max_batch_size, const int replicas = 1);
+
+		/* The engine is owned once, pass the classifier by reference */
+		Classifier(const Classifier&) = delete;
+		Classifier& operator=(const Classifier&) = delete;
 
-		std::vector< vector<Prediction> > ClassifyBatch(const vector< cv::Mat > imgs, int num_classes, int N);
+		std::vector< vector<Prediction> > ClassifyBatch(const vector< cv::Mat >& imgs, int num_classes, int N);
 
-		void setBatchSize (int batch_size);
+		void setProfiler (Profiler *profiler);
+
+		int replicas() const { return engines_.size(); }
 
 		static bool PairCompare(const std::pair<float, int>& lhs, const std::pair<float, int>& rhs);
 
 		static std::vector<int> Argmax(const std::vector<float>& v, int N);
 
+		static void PreprocessImage(const cv::Mat& img, cv::Size geometry, const std::vector<float>& mean, float* output);
+
+		static void PreprocessBatch(const vector<cv::Mat>& imgs, cv::Size geometry, int num_channels, const std::vector<float>& mean, float* input_data);
+
 	private:
-		void SetMean(const string& mean_file);
+		void SetBuckets(int max_batch_size);
+
+		void CheckNet();
+
+		void Replicate(int replicas);
+
+		std::vector<int> AcquireReplicas(size_t wanted);
+
+		void ReleaseReplicas(const std::vector<int>& replicas);
+
+		std::vector< float > PredictBatch(const vector< cv::Mat >& imgs) ;
 
-		std::vector< float > PredictBatch(const vector< cv::Mat > imgs) ;
+		void PredictChunk(InferenceEngine& engine, const vector< cv::Mat >& imgs, float* output);
 
-		void WrapBatchInputLayer(std::vector<std::vector<cv::Mat> > *input_batch);
+		int BucketIndex(int num) const;
 
-		void PreprocessBatch(const vector<cv::Mat> imgs, std::vector< std::vector<cv::Mat> >* input_batch);
+		friend class ReplicaBody;
 };
 
 #endif /* SRC_CLASSIFIER_HPP_ */
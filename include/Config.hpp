@@ -0,0 +1,11 @@
+#ifndef SRC_CONFIG_HPP_
+#define SRC_CONFIG_HPP_
+
+#include "../include/Pipeline.hpp"
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+po::options_description configFileOptions(Parameters &params);
+
+#endif /* SRC_CONFIG_HPP_ */
@@ -0,0 +1,43 @@
+#ifndef SRC_DNNENGINE_HPP_
+#define SRC_DNNENGINE_HPP_
+
+#include "../include/InferenceEngine.hpp"
+#include <opencv2/dnn.hpp>
+
+/* Inference through the DNN module of OpenCV, which loads the same Caffe files and runs its own CPU kernels,
+ * parallelized with the threads of OpenCV. As with Caffe, there is a net for each batch size, so that none
+ * of them is ever reshaped, and each one reads its input from a buffer of its own */
+class DnnEngine : public InferenceEngine {
+
+	private:
+		std::vector<cv::dnn::Net> 			nets_;		//The imported net, once per batch size
+		std::vector<int> 					sizes_;		//Batch size of each net
+		std::vector< std::vector<float> > 	inputs_;	//Input of each net
+		cv::Mat 							output_;	//Output of the last forward pass
+		int 								channels_;	//Channels of the input layer
+		cv::Size 							geometry_;	//Width and height of the input layer
+		int 								outputSize_;//Values produced for each image
+		std::string 						model_file_;	//Files of the net, loaded again by the replicas
+		std::string 						trained_file_;
+
+	public:
+		DnnEngine(const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes);
+
+		int inputChannels() const { return channels_; }
+
+		cv::Size inputGeometry() const { return geometry_; }
+
+		int outputSize() const { return outputSize_; }
+
+		float *input(int size);
+
+		const float *forward(int size);
+
+		/* The DNN module has no way to share the weights between two nets, so the replica loads its own copy */
+		std::unique_ptr<InferenceEngine> replicate() const;
+
+	private:
+		int index(int size) const;
+};
+
+#endif /* SRC_DNNENGINE_HPP_ */
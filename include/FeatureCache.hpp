@@ -0,0 +1,22 @@
+#ifndef SRC_FEATURECACHE_HPP_
+#define SRC_FEATURECACHE_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/* Color statistics of the rectangles of a frame, optionally restricted to the pixels of a mask.
+ * The mean colors of all the objects are computed once per frame, by averaging the pixels of each rectangle, and then
+ * shared by every comparison of the tracks with the objects */
+class FeatureCache {
+
+	private:
+		cv::Mat image_;		//Frame the statistics refer to (BGR)
+		cv::Mat mask_;		//Pixels considered, all of them if empty
+
+	public:
+		void reset(cv::Mat image, cv::Mat mask = cv::Mat());
+
+		void meanColors(const std::vector<cv::Rect> &recs, std::vector<cv::Vec3f> &colors);
+};
+
+#endif /* SRC_FEATURECACHE_HPP_ */
@@ -0,0 +1,33 @@
+#ifndef SRC_FOREGROUNDFILTER_HPP_
+#define SRC_FOREGROUNDFILTER_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+#define GAUSSIAN_MAX_SIZE 		11				//Largest blur kernel applied exactly, larger ones are approximated by box filters
+#define BOX_FILTER_PASSES 		3				//Box filters that approximate a large blur kernel
+
+/* Noise removal around the background subtraction: blur of the frame before it, closing (dilation, then erosion,
+ * with rectangular kernels) of the foreground mask after it. The kernels are fixed at construction, so nothing
+ * is derived from their sizes at each frame, and the cost of both steps grows little with the sizes:
+ * a large blur kernel is approximated by box filters, whose cost does not depend on their size, and the closing
+ * is computed by a single pass over the mask, with running maxima and minima */
+class ForegroundFilter {
+
+	private:
+		int 				blurSize_;		//Side of the blur kernel
+		int 				dilateSize_;	//Side of the dilation kernel
+		int 				erodeSize_;		//Side of the erosion kernel
+		std::vector<int> 	boxSizes_;		//Box filters equivalent to the blur kernel, empty to apply it exactly
+		std::vector<uint8_t> buffer_;		//Rows of the closing still needed by the following ones
+
+	public:
+		ForegroundFilter(int blurSize = 3, int dilateSize = 3, int erodeSize = 3);
+
+		void blur(const cv::Mat &frame, cv::Mat &blurred) const;
+
+		void close(const cv::Mat &mask, cv::Mat &closed);
+};
+
+#endif /* SRC_FOREGROUNDFILTER_HPP_ */
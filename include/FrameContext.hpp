@@ -0,0 +1,33 @@
+#ifndef SRC_FRAMECONTEXT_HPP_
+#define SRC_FRAMECONTEXT_HPP_
+
+#include "../include/Classifier.hpp"
+#include "../include/FeatureCache.hpp"
+#include <chrono>
+
+/* Work done on a frame. The scheduler of a live stream reduces it when the analysis falls behind the stream */
+enum FrameWork { FULL_ANALYSIS, NO_CLASSIFICATION, NO_DETECTION };
+
+/* Everything produced while analyzing a single frame. It travels through the stages of the pipeline,
+ * so that each stage works on its own frame without sharing global state */
+struct FrameContext {
+	long 							index;			//Position of the frame in the stream
+	std::chrono::steady_clock::time_point captured;	//When the frame was read
+	FrameWork 						work;			//Stages of the analysis run on the frame
+	Mat 							frame; 			//Current frame, from the pool of the stream: objects are views of it
+	Mat 							overlay; 		//Copy of the frame the objects are drawn on, to be shown
+	Mat 							small; 			//Current frame at the detection resolution
+	Mat 							mask;  			//Foreground mask, at the detection resolution
+	vector<Mat> 					boundingBoxes;	//Objects found
+	vector<Rect> 					recs;			//Rectangles of the objects
+	vector<Point2f> 				massCenters;	//Centers of mass of the objects
+	vector<Vec3f> 					colors;			//Mean colors of the objects
+	FeatureCache 					features;		//Color statistics of the frame
+	vector< vector<Prediction> > 	predictions;	//Predictions assigned to the objects
+	int 							objects;		//Number of objects found
+	bool 							globalChange;	//Most of the frame changed at once (a lighting flash), no objects were searched
+
+	FrameContext() : index(0), work(FULL_ANALYSIS), objects(0), globalChange(false) {}
+};
+
+#endif /* SRC_FRAMECONTEXT_HPP_ */
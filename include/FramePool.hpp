@@ -0,0 +1,38 @@
+#ifndef SRC_FRAMEPOOL_HPP_
+#define SRC_FRAMEPOOL_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#define FRAME_POOL_BUFFERS 		4		//Buffers of each geometry allocated at once, beside the ones in flight in the pipeline
+
+/* Image buffers of a stream, allocated once and reused for every frame. A buffer is handed out as a cv::Mat, whose
+ * reference count is the handle: the views cut from it (the objects found, the crops kept by the tracks, the images
+ * waiting for the classifier) share the count, so they keep the frame alive however long they live, and the buffer
+ * is back in the pool as soon as the last of them is released. The pool grows only if all the buffers are held.
+ * Buffers are acquired by the thread reading the stream only, while references can be dropped by any thread */
+class FramePool {
+
+	private:
+		std::vector<cv::Mat> 	buffers_;	//Every buffer allocated, the pool keeps a reference to each of them
+		size_t 					next_;		//Buffer checked first by the next acquisition
+		int 					reserve_;	//Buffers allocated the first time a geometry is requested
+		cv::Mat 				decoded_;	//Frame decoded from the stream, before being resized into a buffer
+
+	public:
+		FramePool(int buffers = FRAME_POOL_BUFFERS);
+
+		/* A buffer of the given size and type no one else references */
+		cv::Mat acquire(cv::Size size, int type);
+
+		/* Buffer the stream is decoded into, at its own resolution. Used by the thread reading the stream only */
+		cv::Mat &decoded() { return decoded_; }
+
+		/* Buffers allocated so far */
+		int allocated() const { return buffers_.size(); }
+
+	private:
+		bool available(const cv::Mat &buffer, cv::Size size, int type) const;
+};
+
+#endif /* SRC_FRAMEPOOL_HPP_ */
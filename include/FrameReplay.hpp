@@ -0,0 +1,68 @@
+#ifndef SRC_FRAMEREPLAY_HPP_
+#define SRC_FRAMEREPLAY_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define REPLAY_MAGIC 			"TMFRAMES"		//First bytes of a replay
+#define REPLAY_VERSION 			1				//Version of the layout, a replay of another version is refused
+#define REPLAY_ALIGN 			64				//Alignment of the frames in the file
+
+/* Start of a replay: the frames follow one after the other, from the given offset (bytes from the start of the file),
+ * each frameStride bytes after the previous one */
+struct ReplayHeader {
+	char 		magic[8];
+	uint32_t 	version;
+	int32_t 	width;			//Columns of the frames
+	int32_t 	height;			//Rows of the frames
+	uint32_t 	reserved;
+	double 		fps;			//Frame rate of the video recorded
+	uint64_t 	frames;			//Frames recorded
+	uint64_t 	rowStride;		//Bytes of a row of BGR pixels
+	uint64_t 	frameStride;	//Bytes of a frame, padded to REPLAY_ALIGN
+	uint64_t 	frameOffset;	//First frame
+	uint64_t 	size;			//Size of the file
+};
+
+/* Video decoded once by TrafficMonitoring --record-frames and stored as raw BGR frames, already resized to the
+ * analyzed frame. The file is mapped read only and its frames are handed out as views of the mapping, without
+ * decoding nor copying them, so a replay measures the analysis alone and the replays of the same file share its pages.
+ * The views are valid as long as the replay exists, and must never be written */
+class FrameReplay {
+
+	private:
+		void *					data_;		//Mapping of the file
+		size_t 					size_;		//Size of the mapping
+		ReplayHeader 			header_;	//Geometry of the frames
+		uint64_t 				next_;		//Next frame handed out
+
+	public:
+		FrameReplay(const std::string &replay_file);
+
+		~FrameReplay();
+
+		/* The mapping is owned once */
+		FrameReplay(const FrameReplay&) = delete;
+		FrameReplay& operator=(const FrameReplay&) = delete;
+
+		/* View of the next frame, false once all the frames have been read */
+		bool next(cv::Mat &frame);
+
+		/* View of the given frame */
+		cv::Mat frame(uint64_t index) const;
+
+		uint64_t frames() const { return header_.frames; }
+
+		cv::Size frameSize() const { return cv::Size(header_.width, header_.height); }
+
+		double fps() const { return header_.fps; }
+
+		/* Whether the file starts as a replay, so that it is read as such instead of as a video */
+		static bool isReplay(const std::string &file);
+};
+
+void recordReplay(const std::string &video_file, const std::string &replay_file, cv::Size size);
+
+#endif /* SRC_FRAMEREPLAY_HPP_ */
@@ -0,0 +1,77 @@
+#ifndef SRC_FRAMESCHEDULER_HPP_
+#define SRC_FRAMESCHEDULER_HPP_
+
+#include "../include/FrameContext.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#define SCHEDULER_MAX_LEVEL 		4		//Heaviest load: no classification, detection on one frame of 8
+#define SCHEDULER_SETTLE_FRAMES 	5		//Frames shown after a change of the load level before it is raised again
+#define SCHEDULER_RECOVERY_FRAMES 	30		//Frames well within the target latency before the load level is lowered
+#define PACED_DEFAULT_FPS 			25		//Frame rate of a paced video that does not report its own
+
+/* Capture thread of a live stream: the frames are read as soon as they are available and only the latest one is kept,
+ * so the analysis always takes the most recent frame instead of falling behind the stream (latest frame wins).
+ * A video file can be paced at its frame rate, to be analyzed as if it came from a camera */
+class FrameGrabber {
+
+	private:
+		VideoCapture &						input_;		//Stream read by the capture thread only
+		double 								interval_;	//Time (ms) between two frames of a paced video, 0 for a camera
+		Mat 								latest_;	//Last frame captured
+		std::chrono::steady_clock::time_point captured_;	//When the last frame was captured
+		bool 								fresh_;		//The last frame has not been taken yet
+		bool 								over_;		//The stream has no more frames
+		bool 								stopped_;	//The capture has been stopped
+		long 								dropped_;	//Frames replaced before being taken
+		std::mutex 							mutex_;
+		std::condition_variable 			available_;
+		std::thread 						thread_;
+
+	public:
+		FrameGrabber(VideoCapture &input, bool paced);
+
+		~FrameGrabber();
+
+		bool next(FrameContext &ctx, Mat &frame);
+
+		void stop();
+
+		long dropped();
+
+	private:
+		void run();
+};
+
+/* Load-adaptive scheduling of the frames of a live stream. The end-to-end latency of every frame shown (from its capture
+ * to its display) is averaged; while the average exceeds the target, the work on the following frames is reduced one
+ * level at a time: first classification is skipped (tracks keep following the objects by their motion and are classified
+ * once the load drops), then detection is run on one frame of 2, 4 and 8. The level is lowered again once the average
+ * stays under half the target. With no target every frame is analyzed fully */
+class FrameScheduler {
+
+	private:
+		float 		targetLatency_;	//Latency (ms) to keep, 0 to analyze every frame fully
+		int 		level_;			//Current load level, from 0 (full analysis) to SCHEDULER_MAX_LEVEL
+		double 		latency_;		//Moving average of the latency (ms)
+		int 		settled_;		//Frames shown since the last change of the level
+		int 		calm_;			//Consecutive frames with the average under half the target
+		long 		planned_;		//Frames planned at the current level
+		long 		shown_;			//Frames shown
+		long 		work_[3];		//Frames shown for each kind of work
+		double 		latencySum_;	//Sum of the latencies (ms)
+		double 		latencyMax_;	//Highest latency (ms)
+		std::mutex 	mutex_;
+
+	public:
+		explicit FrameScheduler(float targetLatency = 0);
+
+		FrameWork plan();
+
+		void done(const FrameContext &ctx);
+
+		void printStatistics(ostream &out, long dropped);
+};
+
+#endif /* SRC_FRAMESCHEDULER_HPP_ */
@@ -0,0 +1,46 @@
+#ifndef SRC_INFERENCEENGINE_HPP_
+#define SRC_INFERENCEENGINE_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Forward pass of a network on batches of preprocessed images, independent from the library that runs it.
+ * The batch sizes are fixed at load time: a batch is written to the input of its size, then forwarded */
+class InferenceEngine {
+
+	public:
+		virtual ~InferenceEngine() {}
+
+		/* Channels of the input layer */
+		virtual int inputChannels() const = 0;
+
+		/* Width and height of the input layer */
+		virtual cv::Size inputGeometry() const = 0;
+
+		/* Values produced for each image */
+		virtual int outputSize() const = 0;
+
+		/* Input of a batch of the given size, as size x channels x height x width floats */
+		virtual float *input(int size) = 0;
+
+		/* Forward the batch written to the input of the given size, return size x outputSize floats */
+		virtual const float *forward(int size) = 0;
+
+		/* Another engine of the same net, with inputs, activations and outputs of its own, so that both can forward
+		 * batches at the same time. The weights are shared whenever the library allows it, and the replica must not
+		 * outlive the engine it comes from */
+		virtual std::unique_ptr<InferenceEngine> replicate() const = 0;
+};
+
+std::unique_ptr<InferenceEngine> createInferenceEngine(const std::string &backend, const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes, bool use_GPU);
+
+std::vector<float> readMeanValues(const std::string &mean_file);
+
+std::vector<std::string> readLabels(const std::string &label_file);
+
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value);
+
+#endif /* SRC_INFERENCEENGINE_HPP_ */
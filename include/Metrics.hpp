@@ -0,0 +1,171 @@
+#ifndef SRC_METRICS_HPP_
+#define SRC_METRICS_HPP_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#define METRICS_MAX_STAGES 		32		//Stages whose latency is measured, the ones beyond are not recorded
+#define METRICS_MAX_BUCKETS 	16		//Upper bounds of a histogram, besides +Inf
+
+/* Counters of the analysis. The frames are counted by the work done on them, in the order of FrameWork */
+enum MetricCounter { FRAMES_FULL_ANALYSIS, FRAMES_NO_CLASSIFICATION, FRAMES_NO_DETECTION, FRAMES_DROPPED, FRAMES_OVER_MAX_OBJECTS,
+	FRAMES_GLOBAL_CHANGE, LIVE_TRACKS, METRIC_COUNTERS };
+
+/* Distributions of the analysis, besides the latency of the stages */
+enum MetricHistogram { OBJECTS_PER_FRAME, BATCH_SIZE, METRIC_HISTOGRAMS };
+
+/* Samples of a histogram: how many fall in each bucket (the last one past every bound), and their sum */
+struct HistogramShard {
+	std::atomic<uint64_t> 	buckets[METRICS_MAX_BUCKETS + 1];
+	std::atomic<double> 	sum;
+};
+
+/* Metrics recorded by a single thread. Only that thread writes them, with plain loads and stores instead of locks or
+ * atomic read-modify-write, so recording costs a few instructions on memory no other thread writes; the exporter
+ * reads them, without stopping the thread, to merge them with the ones of the other threads */
+struct MetricShard {
+	std::atomic<int64_t> 	counters[METRIC_COUNTERS];
+	HistogramShard 			histograms[METRIC_HISTOGRAMS];
+	HistogramShard 			stages[METRICS_MAX_STAGES];
+	std::vector< std::pair<const char *, int> > stageIndex;	//Stages already recorded by the thread, by the address of their name
+
+	MetricShard();
+};
+
+class MetricProbe;
+
+/* Always-on instrumentation of the analysis: counters, histograms of the objects per frame and of the batch sizes, and
+ * the latency of every stage measured by a StageTimer. Each thread records into its own shard, and the shards are
+ * merged only when the metrics are exported. Values kept elsewhere, like the depth of the queues, are read through
+ * probes at that time. Nothing is recorded until the metrics are enabled */
+class Metrics {
+
+	private:
+		bool 						enabled_;	//Set before the threads of the analysis start
+		std::vector<std::string> 	stages_;	//Names of the stages, in order of first appearance
+		std::vector<MetricShard *> 	shards_;	//Shard of every thread that recorded something, never released
+		std::vector<MetricProbe *> 	probes_;	//Probes alive
+		std::mutex 					shardMutex_;	//Protects the stages and the shards, never held while taking another lock
+		std::mutex 					probeMutex_;	//Protects the probes, held while they are read
+
+	public:
+		Metrics() : enabled_(false) {}
+
+		void enable(bool enabled = true) { enabled_ = enabled; }
+
+		bool enabled() const { return enabled_; }
+
+		void count(MetricCounter counter, int64_t value = 1){
+			if(!enabled_)
+				return;
+			std::atomic<int64_t> &total = shard().counters[counter];
+			total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		void observe(MetricHistogram histogram, double value);
+
+		void observeStage(const char *stage, double ms);
+
+		/* Text exposition format of Prometheus */
+		std::string prometheus();
+
+		/* Snapshot of the same values as a JSON object */
+		std::string json();
+
+	private:
+		friend class MetricProbe;
+
+		MetricShard &shard();
+
+		int stageIndex(MetricShard &shard, const char *stage);
+
+		void merge(std::vector<int64_t> &counters, std::vector< std::vector<double> > &histograms, std::vector<std::string> &stages);
+};
+
+extern Metrics metrics;
+
+/* Value kept by another object, read when the metrics are exported (the depth of a queue). The probe unregisters
+ * itself when destroyed, so it must not outlive the object it reads */
+class MetricProbe {
+
+	private:
+		std::string 				family_;	//Name of the metric
+		std::string 				labels_;	//Labels of this series, as name="value" pairs separated by commas
+		std::string 				help_;
+		bool 						counter_;	//Counter or gauge
+		std::function<double()> 	read_;
+
+	public:
+		MetricProbe(const std::string &family, const std::string &labels, const std::string &help, bool counter, std::function<double()> read);
+
+		~MetricProbe();
+
+		MetricProbe(const MetricProbe&) = delete;
+		MetricProbe& operator=(const MetricProbe&) = delete;
+
+	private:
+		friend class Metrics;
+};
+
+/* Share of an object in a gauge summed over several objects, like the tracks of every stream. The share is withdrawn
+ * when the object is destroyed; a copy starts without any share, until it sets its own */
+class MetricGauge {
+
+	private:
+		MetricCounter 	gauge_;
+		int64_t 		share_;		//Value added to the gauge
+
+	public:
+		explicit MetricGauge(MetricCounter gauge) : gauge_(gauge), share_(0) {}
+
+		MetricGauge(const MetricGauge &other) : gauge_(other.gauge_), share_(0) {}
+
+		MetricGauge& operator=(const MetricGauge&) { return *this; }
+
+		~MetricGauge() { metrics.count(gauge_, -share_); }
+
+		void set(int64_t value){
+			if(!metrics.enabled())
+				return;
+			metrics.count(gauge_, value - share_);
+			share_ = value;
+		}
+};
+
+/* Label of a series, with the value escaped */
+std::string metricLabel(const std::string &name, const std::string &value);
+
+/* Serves the metrics over HTTP, on a local TCP port and/or a Unix socket (GET /metrics in the Prometheus format, GET /json
+ * as JSON), and periodically writes the JSON snapshot to a file. Runs on its own thread */
+class MetricsExporter {
+
+	private:
+		int 				tcp_;		//Listening sockets, -1 if not used
+		int 				unix_;
+		std::string 		socketPath_;
+		std::string 		snapshotFile_;
+		int 				interval_;	//Seconds between two snapshots
+		std::atomic<bool> 	stopped_;
+		std::thread 		thread_;
+
+	public:
+		MetricsExporter(int port, const std::string &socket_path, const std::string &snapshot_file, int interval);
+
+		~MetricsExporter();
+
+		void stop();
+
+	private:
+		void run();
+
+		void serve(int listener);
+
+		void writeSnapshot();
+};
+
+#endif /* SRC_METRICS_HPP_ */
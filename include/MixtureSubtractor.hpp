@@ -0,0 +1,45 @@
+#ifndef SRC_MIXTURESUBTRACTOR_HPP_
+#define SRC_MIXTURESUBTRACTOR_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+#define MIXTURE_MODES 			5				//Gaussian components of each pixel
+#define MIXTURE_LANES 			8				//Consecutive pixels of a row updated together
+
+/* Gaussian mixtures of MIXTURE_LANES consecutive pixels of a row, in fixed point: weights scaled by 65535,
+ * means and variances by 256. Each field holds the same component of all the pixels of the block,
+ * so that the pixels are updated together with vector instructions, and every block starts on a cache line */
+struct MixtureBlock {
+	uint16_t weight[MIXTURE_MODES][MIXTURE_LANES];			//Weight of each component
+	uint16_t variance[MIXTURE_MODES][MIXTURE_LANES];		//Variance of each component, the same for the three channels
+	uint16_t mean[MIXTURE_MODES][3][MIXTURE_LANES];			//Mean of each channel (BGR) of each component
+	uint8_t  modes[MIXTURE_LANES];							//Components in use, sorted by decreasing weight
+	uint8_t  padding[64 - (5 * MIXTURE_MODES * MIXTURE_LANES * 2 + MIXTURE_LANES) % 64];
+};
+
+/* Background subtractor following the model and the update rules of MOG2 (default parameters, no shadow detection),
+ * with a more compact model that is updated MIXTURE_LANES pixels at a time. The frame is split into horizontal
+ * stripes updated in parallel. It accepts only BGR frames of 8 bit per channel */
+class MixtureSubtractor : public cv::BackgroundSubtractor {
+
+	private:
+		int 				history_;		//Frames that affect the model, when the learning rate is automatic
+		float 				varThreshold_;	//Squared Mahalanobis distance of a background pixel from its component
+		double 				learningRate_;	//Learning rate, negative to derive it from the history
+		cv::Size 			size_;			//Size of the frames modeled
+		int 				blocksPerRow_;	//Blocks of each row
+		long 				frames_;		//Frames seen since the model was created
+		std::vector<uint8_t> buffer_;		//Memory of the model
+		MixtureBlock *		model_;			//Blocks of the model, row by row, aligned to a cache line
+
+	public:
+		MixtureSubtractor(int history = 500, float varThreshold = 16, double learningRate = -1);
+
+		void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate = -1);
+
+		void getBackgroundImage(cv::OutputArray backgroundImage) const;
+};
+
+#endif /* SRC_MIXTURESUBTRACTOR_HPP_ */
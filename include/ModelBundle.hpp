@@ -0,0 +1,98 @@
+#ifndef SRC_MODELBUNDLE_HPP_
+#define SRC_MODELBUNDLE_HPP_
+
+#include "../include/NativeEngine.hpp"
+#include <stdint.h>
+
+#define BUNDLE_MAGIC 			"TMBUNDLE"		//First bytes of a bundle
+#define BUNDLE_VERSION 			1				//Version of the layout, a bundle of another version is refused
+#define BUNDLE_ALIGN 			64				//Alignment of each section of the bundle
+
+/* Start of a bundle: the sections follow at the given offsets (bytes from the start of the file), in the byte
+ * order of the machine that compiled it */
+struct BundleHeader {
+	char 		magic[8];
+	uint32_t 	version;
+	uint32_t 	lanes;			//Channels of a block of the weights, NATIVE_LANES of the compiler
+	int32_t 	input;			//Input blob of the net
+	int32_t 	output;			//Output blob of the net
+	uint32_t 	means;			//Mean value of each input channel (float)
+	uint32_t 	buffers;		//Buffers of a workspace (BundleBuffer)
+	uint32_t 	blobs;			//Blobs (BundleBlob)
+	uint32_t 	layers;			//Layers (BundleLayer)
+	uint32_t 	labels;			//Labels of the output, one string after the other, each ending with a zero
+	uint32_t 	reserved;
+	uint64_t 	labelBytes;		//Size of the labels
+	uint64_t 	parameters;		//Parameters of the layers (float), laid out for the kernels
+	uint64_t 	meanOffset;
+	uint64_t 	bufferOffset;
+	uint64_t 	blobOffset;
+	uint64_t 	layerOffset;
+	uint64_t 	labelOffset;
+	uint64_t 	parameterOffset;
+	uint64_t 	size;			//Size of the file
+};
+
+struct BundleBuffer {
+	int32_t 	blocks;
+	int32_t 	height;
+	int32_t 	width;
+	int32_t 	border;
+};
+
+struct BundleBlob {
+	int32_t 	buffer;
+	int32_t 	firstBlock;
+	int32_t 	channels;
+};
+
+struct BundleLayer {
+	int32_t 	type;
+	int32_t 	bottom;
+	int32_t 	top;
+	int32_t 	kernel;
+	int32_t 	stride;
+	int32_t 	pad;
+	int32_t 	relu;
+	int32_t 	reserved;
+	uint64_t 	weights;
+	uint64_t 	bias;
+};
+
+/* Net, mean values and labels compiled into a single file by TrafficMonitoring --compile-model, for the native
+ * backend. The file is mapped read only, so processes loading the same bundle share its pages, and the parameters
+ * of the layers are used in place: loading only checks the header and copies the few records of the layers */
+class ModelBundle {
+
+	private:
+		void *					data_;		//Mapping of the file
+		size_t 					size_;		//Size of the mapping
+		NativeNet 				net_;		//Layers of the net
+		const float *			parameters_;//Parameters of the layers, in the mapping
+		std::vector<float> 		means_;		//Mean value of each input channel
+		std::vector<std::string> labels_;	//Labels of the output
+
+	public:
+		ModelBundle(const std::string &bundle_file);
+
+		~ModelBundle();
+
+		/* The mapping is owned once */
+		ModelBundle(const ModelBundle&) = delete;
+		ModelBundle& operator=(const ModelBundle&) = delete;
+
+		const NativeNet &net() const { return net_; }
+
+		const float *parameters() const { return parameters_; }
+
+		const std::vector<float> &meanValues() const { return means_; }
+
+		const std::vector<std::string> &labels() const { return labels_; }
+
+		static void write(const std::string &bundle_file, const NativeNet &net, const std::vector<float> &parameters,
+				const std::vector<float> &means, const std::vector<std::string> &labels);
+};
+
+void compileModelBundle(const std::string &net_path, const std::string &bundle_file);
+
+#endif /* SRC_MODELBUNDLE_HPP_ */
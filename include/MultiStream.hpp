@@ -0,0 +1,29 @@
+#ifndef SRC_MULTISTREAM_HPP_
+#define SRC_MULTISTREAM_HPP_
+
+#include "../include/Pipeline.hpp"
+
+/* State of a single video stream, when several streams are analyzed by the same process */
+struct Stream {
+	string 							source;		//Video path or camera index
+	VideoCapture 					input;		//Input stream
+	std::unique_ptr<FrameReplay> 	replay;		//Frames recorded with --record-frames, read instead of the input stream
+	std::unique_ptr<FrameGrabber> 	grabber;	//Capture thread, if the stream is live
+	FrameScheduler 					scheduler;	//Work on each frame, reduced when a live stream falls behind
+	FramePool 						pool;		//Buffers of the frames of the stream
+	Ptr<BackgroundSubtractor> 		subtractor;	//Background Subtraction method of the stream
+	ForegroundFilter 				filter;		//Blur and morphology of the stream
+	ChangeGate 						gate;		//Global changes of the scene of the stream
+	BlobDetector 					detector;	//Connected components of the masks of the stream
+	RegionOfInterest 				roi;		//Part of the frame analyzed
+	Tracker 						tracker;	//Tracks of the objects of the stream
+	BoundedQueue<FramePtr> 			analyzed;	//Frames ready to be shown
+	MetricProbe 					analyzedProbe;	//Exports the depth of the queue
+
+	Stream(const string &source, int queueSize, int targetLatency) : source(source), scheduler(targetLatency), pool(queueSize + FRAME_POOL_BUFFERS), analyzed(queueSize),
+		analyzedProbe("tm_queue_depth", metricLabel("queue", "analyzed") + "," + metricLabel("stream", source), "Frames waiting between two stages of the analysis", false, [this]{ return (double) analyzed.size(); }) {}
+};
+
+void  analyzeVideoStreams(const Parameters &params);
+
+#endif /* SRC_MULTISTREAM_HPP_ */
@@ -0,0 +1,114 @@
+#ifndef SRC_NATIVEENGINE_HPP_
+#define SRC_NATIVEENGINE_HPP_
+
+#include "../include/InferenceEngine.hpp"
+#include <mutex>
+
+#define NATIVE_LANES 			8				//Channels of a block, stored together and computed with vector instructions
+
+/* Activations of a layer, or of the layers concatenated in it, for one image: blocks of NATIVE_LANES channels, each made
+ * of (height + 2 border) x (width + 2 border) pixels of NATIVE_LANES values. The border is zero, so that the padded
+ * convolutions read it without bound checks */
+struct NativeBuffer {
+	int blocks;					//Blocks of channels
+	int height;					//Rows of the activations
+	int width;					//Columns of the activations
+	int border;					//Zero pixels around the activations
+};
+
+/* Activations of a layer of the net: channels of a buffer, starting from one of its blocks */
+struct NativeBlob {
+	std::string name;			//Name of the top of the layer in the prototxt
+	int buffer;					//Buffer holding the activations
+	int firstBlock;				//First block of the buffer, not zero for all the inputs of a concatenation but the first
+	int channels;				//Channels of the activations
+};
+
+/* Layer run for each image. ReLU is fused in the convolution it follows, dropout is ignored, and the concatenation
+ * is done by the convolutions that write the blocks of its output, so none of them is a layer of its own */
+struct NativeLayer {
+	enum Type {CONVOLUTION, MAX_POOLING, AVE_POOLING, SOFTMAX};
+	Type 				type;
+	int 				bottom;		//Input blob
+	int 				top;		//Output blob
+	int 				kernel;		//Size of the square kernel
+	int 				stride;
+	int 				pad;
+	bool 				relu;		//Whether the output of the convolution goes through a ReLU
+	size_t 				weights;	//Offset in the parameters of the weights of the convolution: output blocks x input blocks
+									//x kernel x kernel x NATIVE_LANES input channels x NATIVE_LANES output channels
+	size_t 				bias;		//Offset in the parameters of the bias of the convolution: output blocks x NATIVE_LANES
+};
+
+/* Layers of a net and the activations they read and write. The parameters of the layers are kept apart,
+ * in a single array, so that they can be read in place from a bundle */
+struct NativeNet {
+	std::vector<NativeBuffer> 	buffers;	//Geometry of the buffers of a workspace
+	std::vector<NativeBlob> 	blobs;		//Input of the net and output of each layer
+	std::vector<NativeLayer> 	layers;		//Layers, in the order they are run
+	int 						input;		//Input blob of the net
+	int 						output;		//Output blob of the net
+
+	int addBlob(const std::string &name, int channels, int height, int width);
+
+	int findBlob(const std::string &name) const;
+
+	/* Width and height of the input */
+	cv::Size geometry() const;
+
+	/* Values produced for each image */
+	int outputSize() const;
+};
+
+NativeNet readNativeNet(const std::string &model_file, const std::string &trained_file, std::vector<float> &parameters);
+
+/* Built-in inference for the SqueezeNet nets of data/nets, without any library: the layers are read from the prototxt,
+ * the weights from the caffemodel, and the net is run with direct convolutions on activations stored in blocks of
+ * channels, which the AVX2/FMA kernels update NATIVE_LANES output channels at a time. The images of a batch are run
+ * in parallel with the threads of OpenCV, each one on a workspace holding all the activations of the net */
+class NativeEngine : public InferenceEngine {
+
+	private:
+		NativeNet 							net_;		//Layers of the net
+		std::vector<float> 					ownParameters_;	//Parameters read from the caffemodel
+		const float *						parameters_;	//Parameters of the layers, owned by the engine or by the caller
+		std::vector<int> 					sizes_;		//Batch sizes
+		std::vector< std::vector<float> > 	inputs_;	//Input of each batch size
+		std::vector< std::vector<float> > 	outputs_;	//Output of each batch size
+		std::vector< std::vector< std::vector<float> > > workspaces_;	//Workspaces not in use
+		std::mutex 							mutex_;		//Protects the workspaces
+
+	public:
+		NativeEngine(const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes);
+
+		NativeEngine(const NativeNet &net, const float *parameters, const std::vector<int> &batchSizes);
+
+		int inputChannels() const { return net_.blobs[net_.input].channels; }
+
+		cv::Size inputGeometry() const { return net_.geometry(); }
+
+		int outputSize() const { return net_.outputSize(); }
+
+		float *input(int size);
+
+		const float *forward(int size);
+
+		/* The replica runs the same layers on the parameters of this engine */
+		std::unique_ptr<InferenceEngine> replicate() const;
+
+		/* Run the net on one image, from the planar input to the planar output */
+		void forwardImage(const float *image, float *output, std::vector< std::vector<float> > &workspace) const;
+
+	private:
+		friend class NativeBody;
+
+		void allocate();
+
+		int index(int size) const;
+
+		std::vector< std::vector<float> > acquireWorkspace();
+
+		void releaseWorkspace(std::vector< std::vector<float> > &workspace);
+};
+
+#endif /* SRC_NATIVEENGINE_HPP_ */
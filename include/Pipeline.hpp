@@ -0,0 +1,103 @@
+#ifndef SRC_PIPELINE_HPP_
+#define SRC_PIPELINE_HPP_
+
+#include "../include/Tracking.hpp"
+#include "../include/BoundedQueue.hpp"
+#include "../include/RegionOfInterest.hpp"
+#include "../include/MixtureSubtractor.hpp"
+#include "../include/ForegroundFilter.hpp"
+#include "../include/ChangeGate.hpp"
+#include "../include/BlobDetector.hpp"
+#include "../include/FrameScheduler.hpp"
+#include "../include/FramePool.hpp"
+#include "../include/FrameReplay.hpp"
+#include <memory>
+
+#define NUM_CLASSES 			9				//Number of possible objects classes
+#define BLUR_KERNEL_SIZE 		11				//Default dimension of the blur kernel
+#define ERODE_KERNEL_SIZE 		11				//Default dimension of the erode kernel
+#define DILATE_KERNEL_SIZE 		11				//Default dimension of the dilate kernel
+#define REFERENCE_HEIGHT 		720				//Frame height the minimum sides of an object refer to
+#define MIN_OBJECT_SIDE 		15				//Minimum short side of an object, on a frame REFERENCE_HEIGHT high
+#define MIN_OBJECT_LONG_SIDE 	40				//Minimum long side of an object, on a frame REFERENCE_HEIGHT high
+
+extern int 		frameWidth;		//Frame width
+extern int 		frameHeight;	//Frame height
+extern float 	frameDiagonal;	//Diagonal of the frame
+extern int 		detectionLevel;	//Pyramid level of the frame where the moving objects are detected
+extern Size 	detectionSize;	//Size of the frame where the moving objects are detected
+
+/* Parameters given through the command line and Config.txt */
+struct Parameters {
+	string 	netPath;			//Path of the CNN
+	string 	backend;			//Inference backend: caffe, opencv or native
+	string 	bundlePath;			//Bundle of the net for the native backend, empty to read the files of the net path
+	string 	videoPath;			//Video path, empty to acquire from the device camera
+	bool 	classification;		//Classification mode
+	bool 	tracking;			//Tracking mode
+	bool 	pipeline;			//Run each stage on its own thread
+	bool 	multiStream;		//Analyze all the video sources of the configuration file
+	bool 	realTime;			//Pace video files at their frame rate, as live streams
+	vector<string> videoSources;	//Video sources analyzed in multi-stream mode
+	vector<string> roi;			//Polygons of the regions of interest
+	int 	sf;					//Scaling factor of the frame
+	int 	detectionLevel;		//Times the frame is halved to detect the moving objects
+	string 	subtractor;			//Background subtractor: mog2 or mixture
+	float 	learningRate;		//Learning rate of the background subtractor, negative to derive it from the frames seen
+	int 	blurSize;			//Dimension of the blur kernel, on the whole frame
+	int 	dilateSize;			//Dimension of the dilate kernel, on the whole frame
+	int 	erodeSize;			//Dimension of the erode kernel, on the whole frame
+	int 	maxObjs;			//Maximum number of objects per frame
+	float 	globalChangeTH;		//Fraction of the frame in the foreground over which nothing is searched in it
+	float 	probTH;				//Probability threshold
+	float 	distanceTH;			//Distance threshold
+	float 	avgColorTH;			//Average color threshold
+	int 	noUpdateTH;			//No update threshold
+	int 	lifetimeTH;			//Lifetime threshold
+	int 	reclassifyBudget;	//Maximum number of tracks classified per frame, 0 to classify each track once
+	string 	assignment;			//Assignment of the objects to the tracks: greedy or global
+	string 	motionModel;		//Motion of the tracks: kalman (constant velocity, predicted) or none (last position)
+	bool 	colorMask;			//Compute the colors of the objects only on their foreground pixels
+	int 	queueSize;			//Frames that can wait between two stages of the pipeline
+	int 	maxBatchSize;		//Maximum number of objects classified together
+	float 	maxBatchWait;		//Maximum time (ms) an object waits for its batch to fill
+	int 	replicas;			//Replicas of the network, sharing its weights, that classify at the same time
+	int 	targetLatency;		//End-to-end latency (ms) kept on live streams
+	int 	metricsPort;		//Local TCP port serving the metrics, 0 for none
+	string 	metricsSocket;		//Unix socket serving the metrics, empty for none
+	string 	metricsSnapshot;	//File where the metrics are written periodically as JSON, empty for none
+	int 	metricsInterval;	//Seconds between two snapshots of the metrics
+};
+
+typedef std::unique_ptr<FrameContext> FramePtr;
+
+void  setFrameGeometry(int sf, int level = 0);
+int   detectionKernelSize(int size);
+bool  notBorderObject(Rect rec, Size frameSize);
+bool  checkDimension(Rect rec, Size frameSize);
+bool  isCameraSource(const string &source);
+bool  openStream(VideoCapture &input, const string &source);
+bool  openStream(VideoCapture &input, std::unique_ptr<FrameReplay> &replay, const string &source);
+bool  isLiveSource(const string &source, const Parameters &params);
+bool  readFrame(VideoCapture &input, FramePool &pool, FrameContext &ctx, bool fromVideo, Profiler *profiler = NULL);
+bool  readFrame(FrameGrabber &grabber, FramePool &pool, FrameContext &ctx, Profiler *profiler = NULL);
+bool  readFrame(FrameReplay &replay, FramePool &pool, FrameContext &ctx, Profiler *profiler = NULL);
+bool  readFrame(VideoCapture &input, FrameGrabber *grabber, FrameReplay *replay, FramePool &pool, FrameContext &ctx, bool fromVideo, Profiler *profiler = NULL);
+std::unique_ptr<Classifier> createClassifier(const Parameters &params);
+std::unique_ptr<MetricsExporter> createMetricsExporter(const Parameters &params);
+Ptr<BackgroundSubtractor> createSubtractor(const Parameters &params);
+ForegroundFilter createForegroundFilter(const Parameters &params);
+ChangeGate createChangeGate(const Parameters &params);
+Tracker createTracker(const Parameters &params);
+void  extractForeground(Ptr<BackgroundSubtractor> subtractor, ForegroundFilter &filter, ChangeGate &gate, FrameContext &ctx, const RegionOfInterest &roi, Profiler *profiler = NULL);
+int   findObjects(FrameContext &ctx, const vector<ForegroundBlob> &blobs, const RegionOfInterest &roi);
+int   detectObjects(BlobDetector &detector, FrameContext &ctx, const RegionOfInterest &roi, Profiler *profiler = NULL);
+void  classifyObjects(ClassificationService &service, FrameContext &ctx, float probTH, Profiler *profiler = NULL);
+void  drawPredictions(FrameContext &ctx, float probTH);
+void  drawObjects(FrameContext &ctx);
+void  classifyObjectsWithTracking(ClassificationService &service, Tracker &tracker, FrameContext &ctx, const Parameters &params, Profiler *profiler = NULL);
+void  analyzeObjects(ClassificationService &service, Tracker &tracker, FrameContext &ctx, const Parameters &params, Profiler *profiler = NULL);
+int   showFrame(Mat frame);
+void  runPipeline(ClassificationService &service, VideoCapture &input, FrameGrabber *grabber, FrameReplay *replay, FrameScheduler &scheduler, Ptr<BackgroundSubtractor> subtractor, const RegionOfInterest &roi, const Parameters &params);
+
+#endif /* SRC_PIPELINE_HPP_ */
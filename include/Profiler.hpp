@@ -0,0 +1,70 @@
+#ifndef SRC_PROFILER_HPP_
+#define SRC_PROFILER_HPP_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include "../include/Metrics.hpp"
+
+/* Latency summary of a single stage, times in milliseconds */
+struct StageStats {
+	std::string name;		//Name of the stage
+	size_t 		samples;	//Number of measures
+	double 		mean;		//Average time
+	double 		p50;		//Median
+	double 		p95;		//95th percentile
+	double 		p99;		//99th percentile
+};
+
+/* Collects the time spent in each stage of the analysis */
+class Profiler {
+
+	private:
+		std::vector<std::string> 						order_;		//Stages in order of first appearance
+		std::map<std::string, std::vector<double> > 	samples_;	//Measures of each stage (ms)
+		std::mutex 										mutex_;
+
+	public:
+		void add(const std::string &stage, double ms);
+
+		std::vector<StageStats> summary();
+
+		void clear();
+
+		static double percentile(const std::vector<double> &sorted, double p);
+};
+
+/* Measure consecutive intervals of code, each lap is recorded as a stage of the profiler and of the metrics.
+ * It does nothing when no profiler is given and the metrics are disabled. The stages are named by string
+ * literals, which the metrics recognize by their address */
+class StageTimer {
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		Profiler * 			profiler_;
+		bool 				active_;
+		Clock::time_point 	last_;
+
+	public:
+		explicit StageTimer(Profiler *profiler) : profiler_(profiler), active_(profiler || metrics.enabled()) {
+			if(active_)
+				last_ = Clock::now();
+		}
+
+		/* Record the time elapsed since the last lap */
+		void lap(const char *stage){
+			if(!active_)
+				return;
+			Clock::time_point now = Clock::now();
+			double ms = std::chrono::duration<double, std::milli>(now - last_).count();
+			if(profiler_)
+				profiler_->add(stage, ms);
+			metrics.observeStage(stage, ms);
+			last_ = now;
+		}
+};
+
+#endif /* SRC_PROFILER_HPP_ */
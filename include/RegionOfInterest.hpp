@@ -0,0 +1,31 @@
+#ifndef SRC_REGIONOFINTEREST_HPP_
+#define SRC_REGIONOFINTEREST_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+/* Parts of the frame of a stream where moving objects are searched, e.g. the roads.
+ * Each polygon is given as "[stream:] x,y x,y x,y ...", with coordinates normalized to the frame size (0 to 1):
+ * the polygons without a stream apply to every stream, the others only to the stream in that position.
+ * Without polygons the whole frame is analyzed */
+class RegionOfInterest {
+
+	private:
+		std::vector< std::vector<cv::Point> > 	polygons_;	//Polygons in pixels
+		cv::Rect 								bounds_;	//Smallest rectangle containing all the polygons
+		cv::Mat 								mask_;		//Pixels inside the polygons, within the bounds
+
+	public:
+		void build(const std::vector<std::string> &specs, int stream, cv::Size frameSize);
+
+		cv::Rect bounds() const { return bounds_; }
+
+		bool empty() const { return polygons_.empty(); }
+
+		bool contains(cv::Point point) const;
+
+		static bool parse(const std::string &spec, int &stream, std::vector<cv::Point2f> &polygon);
+};
+
+#endif /* SRC_REGIONOFINTEREST_HPP_ */
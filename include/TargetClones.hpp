@@ -0,0 +1,17 @@
+#ifndef SRC_TARGETCLONES_HPP_
+#define SRC_TARGETCLONES_HPP_
+
+/* The per-pixel kernels marked KERNEL_TARGETS are compiled twice, the AVX2/FMA version (x86-64-v3) is chosen at run time
+ * on the processors supporting it. Before GCC 12 the same instruction set is named after haswell: "avx2" alone would
+ * leave FMA out. The helpers of the kernels are marked KERNEL_INLINE: always inlined, they are compiled for the
+ * instruction set of each version */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && __GNUC__ >= 12
+#define KERNEL_TARGETS __attribute__((target_clones("arch=x86-64-v3", "default")))
+#elif defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define KERNEL_TARGETS __attribute__((target_clones("arch=haswell", "default")))
+#else
+#define KERNEL_TARGETS
+#endif
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+#endif /* SRC_TARGETCLONES_HPP_ */
@@ -1,60 +1,125 @@
 #ifndef SRC_TRACKING_HPP_
 #define SRC_TRACKING_HPP_
 
-#include "../include/Classifier.hpp"
+#include "../include/FrameContext.hpp"
+#include "../include/ClassificationService.hpp"
+#include "../include/Assignment.hpp"
+#include <functional>
+#include <stdint.h>
+
+#define RECLASSIFY_INTERVAL 	3		//Frames between two classifications of the same track, so that they see different crops
+#define KALMAN_MEASUREMENT_NOISE 	0.005	//Standard deviation of the center of mass of an object, as a fraction of the frame diagonal
+#define KALMAN_ACCELERATION_NOISE 	0.002	//Standard deviation of the change of speed of an object in a frame, same unit
+#define KALMAN_INITIAL_SPEED 	0.02	//Standard deviation of the speed of a new track per frame, same unit
+#define KALMAN_GATE_SIGMAS 		3		//Standard deviations of the innovation within which an object can be assigned to a track
+#define KALMAN_MAX_GATE 		3		//Largest gate of a track, in multiples of distanceTH
 
-extern vector<Mat> 					boundingBoxes;		//Objects found
-extern vector<Rect> 				recs;				//Rectangles of the objects
-extern vector<Point2f> 				massCenters;    	//Centers of mass of the objects
-extern vector< vector<Prediction> > predictions;		//Predictions assigned to the objects
 extern Scalar recColors[8];
 
-class Track{
+/* Probabilities given to each class by the classifications of a track, summed */
+typedef Vec<float, other + 1> ClassVotes;
+
+/* Stable identifier of a track: slot in the low 32 bits, generation of the slot in the high 32 bits.
+ * The identifier of a deleted track is never given to another track */
+typedef uint64_t TrackId;
+
+/* Tracks of the objects of a single video stream.
+ * Every attribute of the tracks is stored in its own column, so that the scans of a frame read contiguous memory,
+ * and the i-th element of each column belongs to the same track. A deleted track is replaced by the last one,
+ * therefore the position of a track may change: the identifiers, mapped to the positions through a slot map, do not.
+ * With the motion model, each track follows its object with a constant velocity Kalman filter: at every frame its
+ * position is predicted from its velocity, the objects are compared with the predicted position, within a gate that
+ * grows with the uncertainty of the prediction, and the position assigned corrects the position and the velocity.
+ * A track without objects keeps moving on the prediction alone, until it is deleted after noUpdateTH frames. The two axes
+ * have the same noise and are measured together, so they share the same covariance */
+class Tracker{
 
 	private:
+		//Read at every frame
+		vector<Point2f> 	positions;				// Position of the centroid, predicted for the current frame with the motion model
+		vector<Point2f> 	velocities;				// Motion of the centroid per frame (pixels), with the motion model
+		vector<Vec3f> 		covariances;			// Variances of the position and of the velocity and their covariance, for each axis,
+													// in fractions of the frame diagonal
+		vector<Vec3f> 		colors;					// Mean color of the image
+		vector<Rect> 		rects;					// Contains the rect of the image
+		vector<char> 		assigned;				// Assigned in the current frame
+		vector<int> 		framesWithoutUpdate;	// Keeps count of the number of consecutive frames, where it is remained unassigned.
+													// If the count exceeds a specified threshold, I assume that the object left the field of view and the track will be removed.
+		vector<int> 		lifeTimes;				// Keeps count of the number of frames since it was created
+													// If the count exceeds a specified threshold, the track becomes old and it will be removed (avoid wrong classifications to last too much)
+		vector<int> 		classIds;				// Class with the most votes, -1 until classified
+		vector<float> 		probs;					// Votes of the class over the number of classifications
+		vector<char> 		confident;				// Classified with enough confidence, never classified again
+		//Read only to classify
+		vector<Mat> 		crops;					// Contains the image, released once the track is confident
+		vector<ClassVotes> 	votes;					// Probabilities given to each class by the classifications
+		vector<int> 		classifications;		// Predictions received
+		vector<int> 		framesSinceSubmitted;	// Frames since the last classification was submitted
+		vector<PendingPrediction> pending;			// Classification submitted and not yet assigned to the track
+		vector<TrackId> 	ids;					// Identifier of the track
+
+		//Slot map from the identifiers to the positions in the columns
+		vector<unsigned int> slotIndex;				// Position of the track of each slot
+		vector<unsigned int> slotGeneration;		// Incremented each time the track of the slot is deleted
+		vector<unsigned int> freeSlots;				// Slots without a track
+
+		SpatialGrid   grid;		// Objects of the frame, to find the candidates of each track
+		bool 		  motionModel;	// Predict the positions of the tracks from their velocities
+
+		//Statistics
+		long 		submitted;		// Classifications submitted
+		long 		departed;		// Tracks deleted because their object left the scene
+		MetricGauge liveTracks;		// Tracks counted in the metrics
 
-		float 	x, y;					// Position of the centroid
-		Scalar	avgColor;				// Mean color of the image
-		String 	label;					// Label assigned through classification
-		float   prob;					// Classification probability
-		Rect	rec;					// Contains the rect of the image
-		Mat 	bndBox;					// Contains the image
-		bool 	assigned;				// Assigned in the current frame
-		int 	framesWithoutUpdate;	// Keeps count of the number of consecutive frames, where it is remained unassigned.
-		 	 	 	 	 	 	 		// If the count exceeds a specified threshold, I assume that the object left the field of view and the track will be removed.
-		int 	lifeTime;				// Keeps count of the number of frames since it was created
-										// If the count exceeds a specified threshold, the track becomes old and it will be removed (avoid wrong classifications to last too much)
 	public:
-		static vector<Track> tracks;	// vector containing all the tracks
+		explicit Tracker(bool motionModel = true) : motionModel(motionModel), submitted(0), departed(0), liveTracks(LIVE_TRACKS) {}
+
+		void updateTracks(FrameContext &ctx, float frameDiagonal, float distanceTH, float avgColorTH);
+
+		void assignTracks(FrameContext &ctx, float frameDiagonal, float distanceTH, float avgColorTH);
+
+		void createNewTracks(FrameContext &ctx);
+
+		void classifyTracks(ClassificationService &service, float probTH, int budget);
 
-		Track(float x, float y, Rect rec, Mat bndBox);
+		void deleteUselessTracks(int noUpdateTH, int lifetimeTH, bool restartOld);
 
-		static Point2f computeMassCenter(vector<Point> contours);
+		void drawTracks(Mat frame, float probTH);
 
-		static void updateTracks(float frameDiagonal, float distanceTH, float avgColorTH);
+		TrackId addTrack(Point2f position, Rect rec, Mat bndBox, Vec3f color);
 
-		static void createNewTracks();
+		int indexOf(TrackId id) const;
 
-		static void classifyTracks(Classifier classifier, int classes);
+		int size() const { return ids.size(); }
 
-		static void deleteUselessTracks(int noUpdateTH, int lifetimeTH);
+		TrackId idAt(int index) const { return ids[index]; }
 
-		static void drawTracks(Mat frame, float probTH);
+		Rect rectAt(int index) const { return rects[index]; }
+
+		bool assignedAt(int index) const { return assigned[index]; }
+
+		long classificationsSubmitted() const { return submitted; }
+
+		long trackedObjects() const { return departed + ids.size(); }
 
 	private:
-		void noUpdateThisFrame();
+		void ageTracks();
+
+		void predictTrack(int index);
+
+		float gateOf(int index, float distanceTH) const;
 
-		void gotUpdate();
+		void updateTrack(int index, Point2f position, Rect rec, Mat bndBox, Vec3f color);
 
-		void updateTrack(float x, float y, Rect rec, Mat bndBox);
+		void removeTrack(int index);
 
-		bool checkMeanColor(Mat bndBox, float avgColorTH);
+		void addPrediction(int index, const Prediction &prediction, float probTH, int budget);
 
-		bool massCenterAssignment(float frameDiagonal, float distanceTH, float avgColorTH);
+		float computeColorDistance(int index, Vec3f meanColor) const;
 
-		int findIndexMinElement(double v [], int size);
+		float computeDistanceBetweenObjects(int index, Point2f point, float frameDiagonal) const;
 
-		float computeDistanceBetweenObjects(Point2f point, float frameDiagonal);
+		bool massCenterAssignment(int index, FrameContext &ctx, float frameDiagonal, float distanceTH, float avgColorTH);
 };
 
 #endif /* SRC_TRACKING_HPP_ */
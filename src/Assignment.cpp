@@ -0,0 +1,113 @@
+
+#include "../include/Assignment.hpp"
+#include <limits>
+
+/* Cell containing the coordinate, clamped to the grid */
+int SpatialGrid::cellOf(float coordinate, int cells) const{
+	int cell = (int) (coordinate / cellSize_);
+	return std::max(0, std::min(cell, cells - 1));
+}
+
+/* Sort the points by cell (counting sort, no allocation once the buffers have grown).
+ * With cells as large as the search radius, the neighbors of a position lie in the 3x3 cells around it */
+void SpatialGrid::build(const std::vector<cv::Point2f> &points, cv::Size area, float cellSize){
+	cellSize_ = std::max(cellSize, 1.0f);
+	cols_ = (int) std::ceil(area.width / cellSize_) + 1;
+	rows_ = (int) std::ceil(area.height / cellSize_) + 1;
+
+	cellStart_.assign(cols_ * rows_ + 1, 0);
+	points_.resize(points.size());
+
+	//Count the points of each cell
+	for(unsigned int i = 0; i < points.size(); i++)
+		cellStart_[cellOf(points[i].y, rows_) * cols_ + cellOf(points[i].x, cols_) + 1]++;
+	for(unsigned int c = 1; c < cellStart_.size(); c++)
+		cellStart_[c] += cellStart_[c - 1];
+
+	//Place each point in its cell
+	std::vector<int> next(cellStart_.begin(), cellStart_.end() - 1);
+	for(unsigned int i = 0; i < points.size(); i++)
+		points_[next[cellOf(points[i].y, rows_) * cols_ + cellOf(points[i].x, cols_)]++] = i;
+}
+
+/* Append to result the points in the cell of center and in the surrounding ones */
+void SpatialGrid::query(cv::Point2f center, std::vector<int> &result) const{
+	int cx = cellOf(center.x, cols_), cy = cellOf(center.y, rows_);
+
+	for(int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows_ - 1); y++)
+		for(int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols_ - 1); x++)
+			for(int i = cellStart_[y * cols_ + x]; i < cellStart_[y * cols_ + x + 1]; i++)
+				result.push_back(points_[i]);
+}
+
+/* Minimum cost assignment between rows and columns of a cost matrix (row-major), Hungarian algorithm
+ * with potentials, O(rows^2 * cols). Return the column assigned to each row, -1 if none: pairs with
+ * cost INFEASIBLE_COST are never assigned */
+std::vector<int> solveAssignment(const std::vector<double> &cost, int rows, int cols){
+	std::vector<int> result(rows, -1);
+	if(rows == 0 || cols == 0)
+		return result;
+
+	//The algorithm needs at least as many columns as rows, otherwise solve the transposed problem
+	if(rows > cols){
+		std::vector<double> transposed(cost.size());
+		for(int r = 0; r < rows; r++)
+			for(int c = 0; c < cols; c++)
+				transposed[c * rows + r] = cost[r * cols + c];
+		std::vector<int> columns = solveAssignment(transposed, cols, rows);
+		for(int c = 0; c < cols; c++)
+			if(columns[c] >= 0)
+				result[columns[c]] = c;
+		return result;
+	}
+
+	//1-based arrays, as in the classic formulation: p[c] is the row assigned to column c
+	const double inf = std::numeric_limits<double>::max();
+	std::vector<double> u(rows + 1, 0), v(cols + 1, 0), minv(cols + 1);
+	std::vector<int> p(cols + 1, 0), way(cols + 1, 0);
+	std::vector<char> used(cols + 1);
+
+	for(int r = 1; r <= rows; r++){
+		p[0] = r;
+		int c0 = 0;
+		std::fill(minv.begin(), minv.end(), inf);
+		std::fill(used.begin(), used.end(), 0);
+		do{
+			used[c0] = 1;
+			int r0 = p[c0], c1 = 0;
+			double delta = inf;
+			for(int c = 1; c <= cols; c++){
+				if(used[c])
+					continue;
+				double reduced = cost[(r0 - 1) * cols + (c - 1)] - u[r0] - v[c];
+				if(reduced < minv[c]){
+					minv[c] = reduced;
+					way[c] = c0;
+				}
+				if(minv[c] < delta){
+					delta = minv[c];
+					c1 = c;
+				}
+			}
+			for(int c = 0; c <= cols; c++){
+				if(used[c]){
+					u[p[c]] += delta;
+					v[c] -= delta;
+				}
+				else
+					minv[c] -= delta;
+			}
+			c0 = c1;
+		}while(p[c0] != 0);
+		do{
+			int c1 = way[c0];
+			p[c0] = p[c1];
+			c0 = c1;
+		}while(c0 != 0);
+	}
+
+	for(int c = 1; c <= cols; c++)
+		if(p[c] != 0 && cost[(p[c] - 1) * cols + (c - 1)] < INFEASIBLE_COST)
+			result[p[c] - 1] = c - 1;
+	return result;
+}
@@ -0,0 +1,1008 @@
+
+#include "../include/Config.hpp"
+#include <climits>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+
+#define ENGINE_TOLERANCE 		1e-4			//Largest difference from caffe of the probability of a class, in --engine-bench
+#define BENCH_WARMUP_FRAMES 	60				//Frames the background subtractors learn from before a bench measures them
+
+/* Write the latency of each stage and the overall throughput in CSV format */
+void writeCSV(ostream &out, const Parameters &params, long frames, double seconds, const vector<StageStats> &stages){
+	out << "# video=" << params.videoPath << ", net=" << params.netPath << ", scaling_factor=" << params.sf
+		<< ", frames=" << frames << ", seconds=" << seconds << ", fps=" << frames / seconds << endl;
+	out << "stage,samples,mean_ms,p50_ms,p95_ms,p99_ms" << endl;
+	for(unsigned int i = 0; i < stages.size(); i++){
+		out << stages[i].name << "," << stages[i].samples << "," << stages[i].mean << ","
+			<< stages[i].p50 << "," << stages[i].p95 << "," << stages[i].p99 << endl;
+	}
+}
+
+/* Write the latency of each stage and the overall throughput in JSON format */
+void writeJSON(ostream &out, const Parameters &params, long frames, double seconds, const vector<StageStats> &stages){
+	out << "{" << endl;
+	out << "  \"video\": \"" << params.videoPath << "\"," << endl;
+	out << "  \"net\": \"" << params.netPath << "\"," << endl;
+	out << "  \"scaling_factor\": " << params.sf << "," << endl;
+	out << "  \"classification\": " << (params.classification ? "true" : "false") << "," << endl;
+	out << "  \"tracking\": " << (params.tracking ? "true" : "false") << "," << endl;
+	out << "  \"frames\": " << frames << "," << endl;
+	out << "  \"seconds\": " << seconds << "," << endl;
+	out << "  \"fps\": " << frames / seconds << "," << endl;
+	out << "  \"stages\": [" << endl;
+	for(unsigned int i = 0; i < stages.size(); i++){
+		out << "    {\"name\": \"" << stages[i].name << "\", \"samples\": " << stages[i].samples
+			<< ", \"mean_ms\": " << stages[i].mean << ", \"p50_ms\": " << stages[i].p50
+			<< ", \"p95_ms\": " << stages[i].p95 << ", \"p99_ms\": " << stages[i].p99 << "}"
+			<< (i + 1 < stages.size() ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+/* Replay the video as fast as possible, without showing it, measuring each stage of the analysis */
+void benchmarkVideoStream(const Parameters &params, long maxFrames, Profiler &profiler, Tracker &tracker, long &frames, double &seconds){
+	Ptr<BackgroundSubtractor> subtractor;	//Background Subtraction method
+	VideoCapture input;					//Input stream
+	std::unique_ptr<FrameReplay> replay;	//Frames recorded with --record-frames, read instead of the input stream
+	FramePool pool;						//Buffers of the frames
+	FrameContext ctx;					//Current frame
+	RegionOfInterest roi;				//Part of the frame analyzed
+	ForegroundFilter filter;			//Blur and morphology of the mask
+	ChangeGate gate = createChangeGate(params);	//Global changes of the scene
+	BlobDetector detector;				//Connected components of the mask
+
+	/* Load the net, mean image and labels */
+	std::unique_ptr<Classifier> classifier = createClassifier(params);
+	classifier->setProfiler(&profiler);
+	ClassificationService service(*classifier, NUM_CLASSES, params.maxBatchSize, params.maxBatchWait);
+
+	if (isCameraSource(params.videoPath) || !openStream(input, replay, params.videoPath)) {
+		cerr << "ERROR! Unable to open video stream\n";
+		exit(EXIT_FAILURE);
+	}
+
+	//Create the background subtractor
+	subtractor = createSubtractor(params);
+
+	//Set the frame dimensions
+	setFrameGeometry(params.sf, params.detectionLevel);
+	roi.build(params.roi, 0, detectionSize);
+	filter = createForegroundFilter(params);
+
+	frames = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while(maxFrames <= 0 || frames < maxFrames){
+		StageTimer timer(&profiler);
+
+		if(!readFrame(input, NULL, replay.get(), pool, ctx, true, &profiler))
+			break;
+		extractForeground(subtractor, filter, gate, ctx, roi, &profiler);
+		detectObjects(detector, ctx, roi, &profiler);
+		analyzeObjects(service, tracker, ctx, params, &profiler);
+
+		timer.lap("frame");
+		ctx.index++;
+		frames++;
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	input.release();
+	subtractor.release();
+
+	//Report the batches achieved by the classifier
+	service.stop();
+	if(params.classification)
+		service.printStatistics(cerr);
+}
+
+/* Preprocessing as done by the previous version of the classifier, kept as reference for the micro-benchmark:
+ * resize, conversion to float, mean subtraction and split, each one as a separate pass with its own temporary images */
+void referencePreprocessing(const vector<Mat> &imgs, Size geometry, const vector<float> &mean, float *input_data){
+	Mat meanImage(geometry, CV_32FC3, Scalar(mean[0], mean[1], mean[2]));
+
+	for(unsigned int i = 0; i < imgs.size(); i++){
+		vector<Mat> channels;
+		for(int c = 0; c < 3; c++)
+			channels.push_back(Mat(geometry, CV_32FC1, input_data + (i * 3 + c) * geometry.area()));
+
+		Mat resized, sampleFloat, normalized;
+		resize(imgs[i], resized, geometry);
+		resized.convertTo(sampleFloat, CV_32FC3);
+		subtract(sampleFloat, meanImage, normalized);
+		split(normalized, channels);
+	}
+}
+
+/* Time a preprocessing function, in microseconds per crop */
+double timePreprocessing(std::function<void()> preprocess, int crops, int iterations){
+	preprocess(); //warm up
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < iterations; i++)
+		preprocess();
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / (iterations * crops);
+}
+
+/* Compare the fused preprocessing of the classifier with the reference one, on crops of random size
+ * taken from a random 16:9 frame */
+void benchmarkPreprocessing(ostream &out, int sf, int batch, int iterations){
+	RNG rng(12345);
+	Mat frame(9 * sf, 16 * sf, CV_8UC3);
+	vector<Mat> crops;
+	vector<float> mean;
+	int geometries[] = {114, 227};
+	int threads = getNumThreads();
+
+	randu(frame, Scalar::all(0), Scalar::all(256));
+	for(int i = 0; i < batch; i++){
+		int width = rng.uniform(40, 200), height = rng.uniform(40, 200);
+		crops.push_back(Mat(frame, Rect(rng.uniform(0, frame.cols - width), rng.uniform(0, frame.rows - height), width, height)));
+	}
+	mean.push_back(104);
+	mean.push_back(117);
+	mean.push_back(123);
+
+	out << "geometry,implementation,threads,batch,us_per_crop,speedup,max_abs_diff" << endl;
+	for(int g = 0; g < 2; g++){
+		Size geometry(geometries[g], geometries[g]);
+		vector<float> reference(batch * 3 * geometry.area()), fused(batch * 3 * geometry.area());
+
+		setNumThreads(1);
+		double referenceTime = timePreprocessing([&]{ referencePreprocessing(crops, geometry, mean, &reference[0]); }, batch, iterations);
+		double fusedTime = timePreprocessing([&]{ Classifier::PreprocessBatch(crops, geometry, 3, mean, &fused[0]); }, batch, iterations);
+		setNumThreads(threads);
+		double parallelTime = timePreprocessing([&]{ Classifier::PreprocessBatch(crops, geometry, 3, mean, &fused[0]); }, batch, iterations);
+
+		//cv::resize works in fixed point on 8-bit images, so the results differ by a fraction of a gray level
+		double maxDiff = 0;
+		for(unsigned int i = 0; i < fused.size(); i++)
+			maxDiff = std::max(maxDiff, (double) std::abs(fused[i] - reference[i]));
+
+		out << geometries[g] << "x" << geometries[g] << ",reference,1," << batch << "," << referenceTime << ",1,0" << endl;
+		out << geometries[g] << "x" << geometries[g] << ",fused,1," << batch << "," << fusedTime << "," << referenceTime / fusedTime << "," << maxDiff << endl;
+		out << geometries[g] << "x" << geometries[g] << ",fused," << threads << "," << batch << "," << parallelTime << "," << referenceTime / parallelTime << "," << maxDiff << endl;
+	}
+}
+
+/* Fill the frame context with square objects of uniform color, centered on the given points */
+void syntheticObjects(FrameContext &ctx, const vector<Point2f> &centers, const vector<Scalar> &colors){
+	ctx.frame = Mat(frameHeight, frameWidth, CV_8UC3, Scalar::all(0));
+	ctx.recs.clear();
+	ctx.boundingBoxes.clear();
+	ctx.massCenters.clear();
+	for(unsigned int i = 0; i < centers.size(); i++){
+		Rect rec = Rect(Point(centers[i].x - 15, centers[i].y - 15), Size(30, 30)) & Rect(0, 0, frameWidth, frameHeight);
+		ctx.recs.push_back(rec);
+		ctx.boundingBoxes.push_back(Mat(ctx.frame, rec));
+		ctx.boundingBoxes.back().setTo(colors[i]);
+		ctx.massCenters.push_back(centers[i]);
+	}
+	ctx.objects = centers.size();
+	ctx.features.reset(ctx.frame);
+	ctx.features.meanColors(ctx.recs, ctx.colors);
+}
+
+/* Compare the greedy and the global assignment of the objects to the tracks, with 10, 50 and 200 objects per frame.
+ * Every object moves by up to half the distance threshold between two frames */
+void benchmarkAssignment(ostream &out, const Parameters &params, int iterations){
+	RNG rng(12345);
+	int sizes[] = {10, 50, 200};
+
+	setFrameGeometry(params.sf, params.detectionLevel);
+	float step = params.distanceTH * frameDiagonal / 2;
+
+	out << "objects,assignment,us_per_frame,assigned" << endl;
+	for(int n = 0; n < 3; n++){
+		vector<Point2f> centers, moved;
+		vector<Scalar> colors;
+		FrameContext previous, current;
+		Tracker initial = createTracker(params);
+
+		for(int i = 0; i < sizes[n]; i++){
+			centers.push_back(Point2f(rng.uniform(20.f, frameWidth - 20.f), rng.uniform(20.f, frameHeight - 20.f)));
+			moved.push_back(centers.back() + Point2f(rng.uniform(-step, step), rng.uniform(-step, step)));
+			colors.push_back(Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)));
+		}
+		syntheticObjects(previous, centers, colors);
+		syntheticObjects(current, moved, colors);
+		initial.createNewTracks(previous);
+
+		for(int global = 0; global < 2; global++){
+			double elapsed = 0;
+			long assigned = 0;
+			for(int i = 0; i < iterations; i++){
+				Tracker tracker = initial;
+				FrameContext ctx = current;
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				if(global)
+					tracker.assignTracks(ctx, frameDiagonal, params.distanceTH, params.avgColorTH);
+				else
+					tracker.updateTracks(ctx, frameDiagonal, params.distanceTH, params.avgColorTH);
+				elapsed += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+				assigned += sizes[n] - ctx.massCenters.size();
+			}
+			out << sizes[n] << "," << (global ? "global" : "greedy") << "," << elapsed / iterations << "," << (double) assigned / iterations << endl;
+		}
+	}
+}
+
+/* Time a function, in milliseconds per call */
+double timeMilliseconds(std::function<void()> function, int iterations){
+	function(); //warm up
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < iterations; i++)
+		function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+/* Random texture, smooth over 1/16 of the frame: the background of the synthetic frames */
+Mat syntheticBackground(Size size){
+	Mat texture(size.height / 16, size.width / 16, CV_8UC3), background;
+	randu(texture, Scalar::all(0), Scalar::all(256));
+	resize(texture, background, size, 0, 0, INTER_CUBIC);
+	return background;
+}
+
+/* Compare the blur and the closing of the foreground filter with the reference ones (GaussianBlur, then dilate and erode
+ * with a structuring element built at each frame), with kernels of 5, 11, 21 and 41 pixels, on a random frame and mask.
+ * Both run on a single thread. Return false if a closing differs from the reference one */
+bool benchmarkFilter(ostream &out, int sf, int iterations){
+	int sizes[] = {5, 11, 21, 41};
+	bool exact = true;
+	int threads = getNumThreads();
+	Mat frame = syntheticBackground(Size(16 * sf, 9 * sf)), noise(9 * sf, 16 * sf, CV_8U), mask;
+
+	randu(noise, Scalar::all(0), Scalar::all(256));
+	threshold(noise, mask, 250, 255, THRESH_BINARY);
+
+	setNumThreads(1);
+	out << "kernel_size,step,implementation,ms,speedup,max_abs_diff" << endl;
+	for(int k = 0; k < 4; k++){
+		int size = sizes[k];
+		ForegroundFilter filter(size, size, size);
+		Mat referenceBlur, filterBlur, referenceMask, filterMask;
+
+		double referenceBlurTime = timeMilliseconds([&]{ GaussianBlur(frame, referenceBlur, Size(size, size), 0); }, iterations);
+		double filterBlurTime = timeMilliseconds([&]{ filter.blur(frame, filterBlur); }, iterations);
+		double referenceCloseTime = timeMilliseconds([&]{
+			dilate(mask, referenceMask, getStructuringElement(MORPH_DILATE, Size(size, size)));
+			erode(referenceMask, referenceMask, getStructuringElement(MORPH_ERODE, Size(size, size)));
+		}, iterations);
+		double filterCloseTime = timeMilliseconds([&]{ filter.close(mask, filterMask); }, iterations);
+
+		//Above GAUSSIAN_MAX_SIZE the blur is approximated, the closing is always the same
+		double blurDiff = norm(referenceBlur, filterBlur, NORM_INF);
+		double closeDiff = norm(referenceMask, filterMask, NORM_INF);
+
+		out << size << ",blur,reference," << referenceBlurTime << ",1,0" << endl;
+		out << size << ",blur,filter," << filterBlurTime << "," << referenceBlurTime / filterBlurTime << "," << blurDiff << endl;
+		out << size << ",closing,reference," << referenceCloseTime << ",1,0" << endl;
+		out << size << ",closing,filter," << filterCloseTime << "," << referenceCloseTime / filterCloseTime << "," << closeDiff << endl;
+		if(closeDiff != 0){
+			cerr << "ERROR! The closing with a kernel of " << size << " pixels differs from the reference one" << endl;
+			exact = false;
+		}
+	}
+	setNumThreads(threads);
+	return exact;
+}
+
+/* Frame of a synthetic scene: a textured background, with noise and a slowly changing light, crossed by colored boxes */
+void syntheticScene(Mat &frame, const Mat &background, long t){
+	RNG boxes(12345);
+	Mat noise(background.size(), CV_16SC3);
+
+	background.convertTo(frame, CV_16SC3, 1 + 0.05 * sin(t / 60.0));
+	randn(noise, Scalar::all(0), Scalar::all(3));
+	frame += noise;
+	frame.convertTo(frame, CV_8UC3);
+
+	for(int i = 0; i < 6; i++){
+		Point2f origin(boxes.uniform(0.f, (float)frame.cols), boxes.uniform(0.f, (float)frame.rows));
+		Point2f speed(boxes.uniform(-6.f, 6.f) * frame.cols / 1280, boxes.uniform(-3.f, 3.f) * frame.rows / 720);
+		Size size(boxes.uniform(40, 120) * frame.cols / 1280, boxes.uniform(30, 80) * frame.rows / 720);
+		Scalar color(boxes.uniform(0, 256), boxes.uniform(0, 256), boxes.uniform(0, 256));
+		Point position((int)(origin.x + speed.x * t) % frame.cols, (int)(origin.y + speed.y * t) % frame.rows);
+		if(position.x < 0) position.x += frame.cols;
+		if(position.y < 0) position.y += frame.rows;
+		rectangle(frame, Rect(position, size), color, CV_FILLED);
+	}
+}
+
+/* Frames of a bench: the video or the replay given with -v, otherwise a synthetic scene */
+struct BenchSource {
+	VideoCapture 					input;
+	std::unique_ptr<FrameReplay> 	replay;
+	FramePool 						pool;
+	Mat 							background;	//Of the synthetic scene
+
+	/* Open the video of the parameters, if any, at the frame geometry already set */
+	void open(const Parameters &params){
+		if(params.videoPath.compare("") != 0 && !openStream(input, replay, params.videoPath)){
+			cerr << "ERROR! Unable to open video stream\n";
+			exit(EXIT_FAILURE);
+		}
+		if(!fromVideo())
+			background = syntheticBackground(Size(frameWidth, frameHeight));
+	}
+
+	bool fromVideo() const{
+		return input.isOpened() || replay;
+	}
+
+	/* Read the next frame of the video, or draw the frame t of the synthetic scene. Return false at the end of the video */
+	bool read(FrameContext &ctx, long t){
+		if(fromVideo())
+			return readFrame(input, NULL, replay.get(), pool, ctx, true);
+		syntheticScene(ctx.frame, background, t);
+		ctx.small = ctx.frame;
+		return true;
+	}
+};
+
+/* Compare the mixture subtractor with MOG2 at the scaling factors 40, 80 and 120, on the same frames:
+ * time of the subtraction, fraction of the mask pixels that agree, objects found by each one and by both.
+ * The frames come from the video if given, otherwise from a synthetic scene */
+void benchmarkSubtractors(ostream &out, Parameters params, long maxFrames){
+	int factors[] = {40, 80, 120};
+
+	if(maxFrames <= 0)
+		maxFrames = 300;
+
+	out << "scaling_factor,subtractor,subtraction_ms,mask_agreement,objects,matched_objects" << endl;
+	for(int f = 0; f < 3; f++){
+		BenchSource source;
+		RegionOfInterest roi;
+		ForegroundFilter filters[2];
+		BlobDetector detectors[2];
+		Ptr<BackgroundSubtractor> subtractors[2];
+		Profiler profilers[2];
+		FrameContext ctx[2];
+		double agreement = 0;
+		long objects[2] = {0, 0}, matched = 0, measured = 0;
+
+		setFrameGeometry(factors[f]);
+		roi.build(vector<string>(), 0, detectionSize);
+		filters[0] = filters[1] = createForegroundFilter(params);
+		ChangeGate gates[2] = {ChangeGate(1, params.learningRate), ChangeGate(1, params.learningRate)};	//Never gate: the masks are compared on every frame
+		params.subtractor = "mog2";
+		subtractors[0] = createSubtractor(params);
+		params.subtractor = "mixture";
+		subtractors[1] = createSubtractor(params);
+		source.open(params);
+
+		for(long t = 0; t < maxFrames; t++){
+			if(!source.read(ctx[0], t))
+				break;
+			ctx[1].frame = ctx[0].frame;
+			ctx[1].small = ctx[0].small;
+
+			for(int s = 0; s < 2; s++){
+				extractForeground(subtractors[s], filters[s], gates[s], ctx[s], roi, t >= BENCH_WARMUP_FRAMES ? &profilers[s] : NULL);
+				detectObjects(detectors[s], ctx[s], roi);
+			}
+			if(t < BENCH_WARMUP_FRAMES)
+				continue;
+
+			agreement += 1 - (double)countNonZero(ctx[0].mask != ctx[1].mask) / ctx[0].mask.total();
+			objects[0] += ctx[0].recs.size();
+			objects[1] += ctx[1].recs.size();
+			for(unsigned int i = 0; i < ctx[0].recs.size(); i++){
+				for(unsigned int j = 0; j < ctx[1].recs.size(); j++){
+					Rect a = ctx[0].recs[i], b = ctx[1].recs[j];
+					if((a & b).area() > 0.8 * (a | b).area()){
+						matched++;
+						break;
+					}
+				}
+			}
+			measured++;
+		}
+
+		for(int s = 0; s < 2; s++){
+			vector<StageStats> stages = profilers[s].summary();
+			double subtraction = 0;
+			for(unsigned int i = 0; i < stages.size(); i++)
+				if(stages[i].name.compare("subtraction") == 0)
+					subtraction = stages[i].mean;
+			out << factors[f] << "," << (s == 0 ? "mog2" : "mixture") << "," << subtraction << ","
+				<< agreement / std::max(measured, 1L) << "," << objects[s] << "," << matched << endl;
+		}
+	}
+}
+
+/* Detection of the objects as done before the connected components of BlobDetector, kept as reference for the benchmark:
+ * external contours of the mask, their bounding rectangles and the centers of mass of the contour polygons. The border
+ * objects were the ones whose contour touched the pixels next to the border, as contours never include the border pixels.
+ * The objects the border rule of notBorderObject rejects are flagged */
+void referenceDetection(FrameContext &ctx, const RegionOfInterest &roi, vector<Rect> &recs, vector<Point2f> &centers, vector<bool> &border){
+	Mat hierarchy;
+	vector<vector<Point> > contours;
+	int scale = 1 << detectionLevel;
+	Rect frameRect(0, 0, ctx.frame.cols, ctx.frame.rows);
+	Size size = ctx.small.size();
+
+	recs.clear();
+	centers.clear();
+	border.clear();
+	findContours(Mat(ctx.mask, roi.bounds()), contours, hierarchy, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE, roi.bounds().tl());
+	for(unsigned int i = 0; i < contours.size(); i++){
+		Rect aux = boundingRect(contours[i]);
+		if(!roi.empty() && !roi.contains(Point(aux.x + aux.width / 2, aux.y + aux.height / 2)))
+			continue;
+		Point topLeft = aux.tl(), bottomRight = aux.br();
+		if(!checkDimension(aux, size) || topLeft.x == 1 || topLeft.y == 1 || bottomRight.x == size.width - 1 || bottomRight.y == size.height - 1)
+			continue;
+
+		Moments mu = moments(contours[i], false);
+		recs.push_back(Rect(aux.x * scale, aux.y * scale, aux.width * scale, aux.height * scale) & frameRect);
+		centers.push_back(Point2f((mu.m10 / mu.m00) * scale + (scale - 1) / 2.f, (mu.m01 / mu.m00) * scale + (scale - 1) / 2.f));
+		border.push_back(!notBorderObject(aux, size));
+	}
+}
+
+/* Compare BlobDetector with the reference detection (findContours, boundingRect and moments) on the same masks, at the
+ * scaling factor of the configuration file: time of the detection, objects found by each one, objects without an object
+ * of the same rectangle in the other one (for the reference, the ones the border rule rejects now are counted apart),
+ * and distance between the centers of mass of the matched objects, in pixels of the frame.
+ * The masks come from the configured subtractor, on the video if given, otherwise on a synthetic scene */
+void benchmarkDetector(ostream &out, const Parameters &params, long maxFrames){
+	BenchSource source;
+	Mat mask;
+	RegionOfInterest roi;
+	FrameContext ctx;
+	BlobDetector detector;
+	vector<Rect> recs;
+	vector<Point2f> centers;
+	vector<bool> border, matched;
+	double ms[2] = {0, 0}, shift = 0, maxShift = 0;
+	long objects[2] = {0, 0}, unmatched[2] = {0, 0}, borderRule = 0, pairs = 0, measured = 0;
+
+	if(maxFrames <= 0)
+		maxFrames = 300;
+	setFrameGeometry(params.sf, params.detectionLevel);
+	roi.build(params.roi, 0, detectionSize);
+	Ptr<BackgroundSubtractor> subtractor = createSubtractor(params);
+	ForegroundFilter filter = createForegroundFilter(params);
+	ChangeGate gate(1, params.learningRate);	//Never gate: every mask is compared
+	source.open(params);
+
+	for(long t = 0; t < maxFrames; t++){
+		if(!source.read(ctx, t))
+			break;
+		extractForeground(subtractor, filter, gate, ctx, roi);
+		if(t < BENCH_WARMUP_FRAMES)
+			continue;
+
+		//The reference works on a copy, as findContours may modify its input
+		ctx.mask.copyTo(mask);
+		std::swap(mask, ctx.mask);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		referenceDetection(ctx, roi, recs, centers, border);
+		ms[0] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::swap(mask, ctx.mask);
+
+		start = std::chrono::steady_clock::now();
+		detectObjects(detector, ctx, roi);
+		ms[1] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		objects[0] += recs.size();
+		objects[1] += ctx.recs.size();
+		matched.assign(ctx.recs.size(), false);
+		for(unsigned int i = 0; i < recs.size(); i++){
+			unsigned int j = 0;
+			while(j < ctx.recs.size() && (matched[j] || ctx.recs[j] != recs[i]))
+				j++;
+			if(j == ctx.recs.size()){
+				unmatched[0]++;
+				borderRule += border[i];
+				continue;
+			}
+			matched[j] = true;
+			double distance = norm(ctx.massCenters[j] - centers[i]);
+			shift += distance;
+			maxShift = std::max(maxShift, distance);
+			pairs++;
+		}
+		unmatched[1] += std::count(matched.begin(), matched.end(), false);
+		measured++;
+	}
+
+	measured = std::max(measured, 1L);
+	out << "implementation,ms_per_frame,objects,unmatched_objects,border_rule,mean_centroid_shift,max_centroid_shift" << endl;
+	out << "reference," << ms[0] / measured << "," << objects[0] << "," << unmatched[0] << "," << borderRule << ",0,0" << endl;
+	out << "detector," << ms[1] / measured << "," << objects[1] << "," << unmatched[1] << ",0," << shift / std::max(pairs, 1L) << "," << maxShift << endl;
+}
+
+/* Sudden change of the lighting of a synthetic scene: from the 100th frame its light is raised by half, as after a
+ * change of exposure. Without the change gate and with it (at globalChangeTH, at 0.5 if the configuration disables it):
+ * frames until the mask has recovered (less than 5% of foreground), objects found and time of the foreground extraction
+ * and detection per frame until then, frames gated */
+void benchmarkChangeGate(ostream &out, Parameters params, long maxFrames){
+	const long changeAt = 100;
+	float thresholds[] = {1, params.globalChangeTH < 1 ? params.globalChangeTH : 0.5f};
+
+	if(maxFrames <= 0)
+		maxFrames = 200;
+	setFrameGeometry(params.sf);
+	Mat background = syntheticBackground(Size(frameWidth, frameHeight));
+
+	out << "gate_threshold,frames_to_recover,objects,ms_per_frame,gated_frames" << endl;
+	for(int g = 0; g < 2; g++){
+		RegionOfInterest roi;
+		roi.build(vector<string>(), 0, detectionSize);
+		Ptr<BackgroundSubtractor> subtractor = createSubtractor(params);
+		ForegroundFilter filter = createForegroundFilter(params);
+		ChangeGate gate(thresholds[g], params.learningRate);
+		BlobDetector detector;
+		FrameContext ctx;
+		long recovered = -1, objects = 0, gated = 0;
+		double ms = 0;
+
+		for(long t = 0; t < changeAt + maxFrames && recovered < 0; t++){
+			syntheticScene(ctx.frame, background, t);
+			if(t >= changeAt)
+				ctx.frame.convertTo(ctx.frame, -1, 1.5);
+			ctx.small = ctx.frame;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			extractForeground(subtractor, filter, gate, ctx, roi);
+			detectObjects(detector, ctx, roi);
+			if(t < changeAt)
+				continue;
+
+			ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			objects += ctx.objects;
+			gated += ctx.globalChange;
+			if(!ctx.globalChange && ChangeGate::foregroundRatio(ctx.mask) < 0.05)
+				recovered = t - changeAt;
+		}
+		long frames = recovered < 0 ? maxFrames : recovered + 1;
+		out << thresholds[g] << "," << (recovered < 0 ? maxFrames : recovered) << "," << objects << "," << ms / frames << "," << gated << endl;
+	}
+}
+
+/* Crops of random position and size, from the frames of the video if given, otherwise from a random textured frame */
+void randomCrops(const Parameters &params, int count, vector<Mat> &crops){
+	RNG rng(12345);
+	BenchSource source;
+	Mat frame;
+
+	setFrameGeometry(params.sf);
+	source.open(params);
+	for(int i = 0; i < count; i++){
+		//A new frame every 8 crops
+		if(i % 8 == 0){
+			FrameContext ctx;
+			//The crops keep their frame out of the pool. The frames of a replay are copied, as its views end with it
+			if(source.fromVideo() && source.read(ctx, i)){
+				frame = source.replay ? ctx.frame.clone() : ctx.frame;
+			}
+			else if(frame.empty()){
+				frame = syntheticBackground(Size(frameWidth, frameHeight));
+			}
+		}
+		int width = rng.uniform(40, 200), height = rng.uniform(40, 200);
+		crops.push_back(Mat(frame, Rect(rng.uniform(0, frame.cols - width), rng.uniform(0, frame.rows - height), width, height)));
+	}
+}
+
+/* Compare the inference backends on all the nets of data/nets: images per second with batches of one image and of
+ * maxBatchSize images, agreement of the top prediction with Caffe and largest difference of the probabilities of all the
+ * classes, on the same crops. Return false if a backend differs from Caffe by more than ENGINE_TOLERANCE */
+bool benchmarkEngines(ostream &out, const Parameters &params, int iterations){
+	vector<String> models;
+	vector<Mat> crops;
+	const char *backends[] = {"caffe", "opencv", "native"};
+	bool identical = true;
+
+	glob("data/nets/*/deploy.prototxt", models, false);
+	randomCrops(params, 64, crops);
+
+	out << "net,backend,batch,images_per_s,top1_agreement,max_prob_diff" << endl;
+	for(unsigned int m = 0; m < models.size(); m++){
+		string netPath = models[m].substr(0, models[m].size() - string("/deploy.prototxt").size());
+		vector< vector<Prediction> > reference;
+
+		for(int b = 0; b < 3; b++){
+			Classifier classifier(netPath + "/deploy.prototxt", netPath + "/deploy.caffemodel", netPath + "/mean.binaryproto", netPath + "/labels.txt", false, params.maxBatchSize, backends[b]);
+			vector< vector<Prediction> > predictions = classifier.ClassifyBatch(crops, NUM_CLASSES, NUM_CLASSES);
+			if(b == 0)
+				reference = predictions;
+
+			//The predictions of all the classes are sorted by probability, the ones of the same class are compared
+			long agree = 0;
+			double maxDiff = 0;
+			for(unsigned int i = 0; i < crops.size(); i++){
+				if(predictions[i][0].first.compare(reference[i][0].first) == 0)
+					agree++;
+				for(unsigned int c = 0; c < reference[i].size(); c++){
+					unsigned int k = 0;
+					while(k < predictions[i].size() && predictions[i][k].first.compare(reference[i][c].first) != 0)
+						k++;
+					maxDiff = std::max(maxDiff, k < predictions[i].size() ? (double) std::abs(predictions[i][k].second - reference[i][c].second) : 1.0);
+				}
+			}
+			if(maxDiff > ENGINE_TOLERANCE){
+				cerr << "ERROR! The " << backends[b] << " backend differs from caffe by " << maxDiff << " on " << netPath << endl;
+				identical = false;
+			}
+
+			double single = timeMilliseconds([&]{
+				for(unsigned int i = 0; i < crops.size(); i++)
+					classifier.ClassifyBatch(vector<Mat>(1, crops[i]), NUM_CLASSES, 1);
+			}, iterations);
+			double batched = timeMilliseconds([&]{ classifier.ClassifyBatch(crops, NUM_CLASSES, 1); }, iterations);
+
+			out << netPath << "," << backends[b] << ",1," << crops.size() * 1000 / single << "," << (double) agree / crops.size() << "," << maxDiff << endl;
+			out << netPath << "," << backends[b] << "," << params.maxBatchSize << "," << crops.size() * 1000 / batched << "," << (double) agree / crops.size() << "," << maxDiff << endl;
+		}
+	}
+	return identical;
+}
+
+/* Time to load the classifier of net_path (net, mean values and labels, up to the first batch it can take) from the
+ * Caffe files with each backend, and from a bundle compiled once from the same files, with the native backend */
+void benchmarkStartup(ostream &out, const Parameters &params, int iterations){
+	const char *backends[] = {"caffe", "opencv", "native"};
+	string bundleFile = "startup-bench.bundle";
+	const string &netPath = params.netPath;
+
+	out << "source,backend,load_ms" << endl;
+	for(int b = 0; b < 3; b++){
+		double load = timeMilliseconds([&]{
+			Classifier classifier(netPath + "/deploy.prototxt", netPath + "/deploy.caffemodel", netPath + "/mean.binaryproto", netPath + "/labels.txt", false, params.maxBatchSize, backends[b]);
+		}, iterations);
+		out << "files," << backends[b] << "," << load << endl;
+	}
+
+	double compile = timeMilliseconds([&]{ compileModelBundle(netPath, bundleFile); }, 1);
+	double load = timeMilliseconds([&]{ Classifier classifier(bundleFile, params.maxBatchSize); }, iterations);
+	out << "compile,native," << compile << endl;
+	out << "bundle,native," << load << endl;
+	remove(bundleFile.c_str());
+}
+
+/* Compare the classification of each track once, restarting the tracks older than lifetimeTH, with the budgeted
+ * classification of the least confident tracks, on the same video with classification and tracking enabled:
+ * classifications submitted, objects tracked (tracks deleted because their object left the scene, or still alive
+ * at the end) and classifications per object */
+void benchmarkReclassification(ostream &out, Parameters params, long maxFrames){
+	int budgets[] = {0, params.reclassifyBudget};
+
+	params.classification = true;
+	params.tracking = true;
+	out << "policy,budget,frames,fps,classifications,tracked_objects,classifications_per_object" << endl;
+	for(int b = 0; b < 2; b++){
+		Profiler profiler;
+		Tracker tracker = createTracker(params);
+		long frames;
+		double seconds;
+
+		params.reclassifyBudget = budgets[b];
+		benchmarkVideoStream(params, maxFrames, profiler, tracker, frames, seconds);
+		out << (b == 0 ? "once" : "budgeted") << "," << budgets[b] << "," << frames << "," << frames / seconds << ","
+			<< tracker.classificationsSubmitted() << "," << tracker.trackedObjects() << ","
+			<< (double) tracker.classificationsSubmitted() / std::max(tracker.trackedObjects(), 1L) << endl;
+	}
+}
+
+/* Compare the tracks without and with the motion model. On a synthetic scene of 20 objects of different colors moving
+ * straight, by 0.5 to 2.5 times distanceTH per frame, bouncing on the borders of the frame, each one missed by the
+ * detection in 10% of the frames: tracks created and identity switches (an object assigned to another track than the
+ * last time it was seen). Tracks live without updates for noUpdateTH frames, as configured, and are never restarted. On the video, if given, with classification and tracking: classifications
+ * submitted, objects tracked and classifications per object, where a track lost and created again counts twice */
+void benchmarkMotion(ostream &out, Parameters params, long maxFrames){
+	const char *models[] = {"none", "kalman"};
+	const int numObjects = 20, syntheticFrames = 300;
+	const float margin = 20;
+
+	setFrameGeometry(params.sf, params.detectionLevel);
+	out << "source,motion_model,frames,tracked_objects,id_switches,classifications,classifications_per_object" << endl;
+	for(int m = 0; m < 2; m++){
+		RNG rng(12345);
+		vector<Point2f> positions, speeds;
+		vector<Scalar> colors;
+		vector<TrackId> identities(numObjects);
+		vector<char> seen(numObjects, 0);
+		long switches = 0;
+
+		params.motionModel = models[m];
+		Tracker tracker = createTracker(params);
+		for(int i = 0; i < numObjects; i++){
+			float angle = rng.uniform(0.f, (float) CV_2PI), speed = rng.uniform(0.5f, 2.5f) * params.distanceTH * frameDiagonal;
+			positions.push_back(Point2f(rng.uniform(margin, frameWidth - margin), rng.uniform(margin, frameHeight - margin)));
+			speeds.push_back(Point2f(speed * cos(angle), speed * sin(angle)));
+			colors.push_back(Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)));
+		}
+
+		for(int t = 0; t < syntheticFrames; t++){
+			vector<Point2f> centers;
+			vector<Scalar> visibleColors;
+			vector<int> visible;
+			for(int i = 0; i < numObjects; i++){
+				positions[i] += speeds[i];
+				if(positions[i].x < margin || positions[i].x > frameWidth - margin)
+					speeds[i].x = -speeds[i].x;
+				if(positions[i].y < margin || positions[i].y > frameHeight - margin)
+					speeds[i].y = -speeds[i].y;
+				positions[i].x = std::min(std::max(positions[i].x, margin), frameWidth - margin);
+				positions[i].y = std::min(std::max(positions[i].y, margin), frameHeight - margin);
+				if(rng.uniform(0.f, 1.f) >= 0.1f){
+					centers.push_back(positions[i]);
+					visibleColors.push_back(colors[i]);
+					visible.push_back(i);
+				}
+			}
+
+			FrameContext ctx;
+			syntheticObjects(ctx, centers, visibleColors);
+			vector<Rect> objectRects = ctx.recs;
+			if(params.assignment.compare("global") == 0)
+				tracker.assignTracks(ctx, frameDiagonal, params.distanceTH, params.avgColorTH);
+			else
+				tracker.updateTracks(ctx, frameDiagonal, params.distanceTH, params.avgColorTH);
+			tracker.createNewTracks(ctx);
+
+			//The track of each object seen is the one that took its rectangle
+			for(unsigned int k = 0; k < visible.size(); k++){
+				for(int j = 0; j < tracker.size(); j++){
+					if(tracker.assignedAt(j) && tracker.rectAt(j) == objectRects[k]){
+						int i = visible[k];
+						if(seen[i] && identities[i] != tracker.idAt(j))
+							switches++;
+						identities[i] = tracker.idAt(j);
+						seen[i] = 1;
+						break;
+					}
+				}
+			}
+			tracker.deleteUselessTracks(params.noUpdateTH, INT_MAX, false);
+		}
+		out << "synthetic," << models[m] << "," << syntheticFrames << "," << tracker.trackedObjects() << "," << switches << ",," << endl;
+	}
+
+	if(params.videoPath.compare("") == 0)
+		return;
+	params.classification = true;
+	params.tracking = true;
+	for(int m = 0; m < 2; m++){
+		Profiler profiler;
+		long frames;
+		double seconds;
+
+		params.motionModel = models[m];
+		Tracker tracker = createTracker(params);
+		benchmarkVideoStream(params, maxFrames, profiler, tracker, frames, seconds);
+		out << "video," << models[m] << "," << frames << "," << tracker.trackedObjects() << ",," << tracker.classificationsSubmitted() << ","
+			<< (double) tracker.classificationsSubmitted() / std::max(tracker.trackedObjects(), 1L) << endl;
+	}
+}
+
+/* Overhead of the metrics: time of a lap of a stage timer without and with the metrics, time to export them, and the
+ * analysis of the video with classification and tracking as given, without and with the metrics. The profiler of the
+ * benchmark times the stages in both runs, so the difference is the cost of the metrics alone */
+void benchmarkMetrics(ostream &out, const Parameters &params, long maxFrames){
+	const int laps = 1000000;
+	double lapTime[2], frameTime[2], fps[2];
+
+	for(int enabled = 0; enabled < 2; enabled++){
+		metrics.enable(enabled);
+		lapTime[enabled] = timeMilliseconds([&]{
+			StageTimer timer(NULL);
+			for(int i = 0; i < laps / 4; i++){
+				timer.lap("bench_a");
+				timer.lap("bench_b");
+				timer.lap("bench_c");
+				timer.lap("bench_d");
+			}
+		}, 1) * 1e6 / laps;
+
+		Profiler profiler;
+		Tracker tracker = createTracker(params);
+		long frames;
+		double seconds;
+		benchmarkVideoStream(params, maxFrames, profiler, tracker, frames, seconds);
+		frameTime[enabled] = seconds * 1000 / std::max(frames, 1L);
+		fps[enabled] = frames / seconds;
+	}
+	double exportTime = timeMilliseconds([&]{ metrics.prometheus(); }, 100);
+
+	out << "metrics,lap_ns,ms_per_frame,fps" << endl;
+	out << "disabled," << lapTime[0] << "," << frameTime[0] << "," << fps[0] << endl;
+	out << "enabled," << lapTime[1] << "," << frameTime[1] << "," << fps[1] << endl;
+	out << "# export_ms=" << exportTime << ", overhead=" << 100 * (frameTime[1] - frameTime[0]) / frameTime[0] << "% of the frame time" << endl;
+	metrics.enable(false);
+}
+
+/* Resident memory of the process, in megabytes */
+double residentMegabytes(){
+	std::ifstream statm("/proc/self/statm");
+	long size = 0, resident = 0;
+	statm >> size >> resident;
+	return (double) resident * sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+/* Scaling of the classifier of net_path with its replicas, from 1 to the replicas of the configuration file (to the
+ * cores if it asks for a single one), doubling them: images per second of a single caller classifying batches
+ * of 4 x maxBatchSize crops, split among the replicas, and of as many callers as replicas classifying batches of
+ * maxBatchSize crops at the same time, each on its own replica. The memory taken by each replica after the first
+ * one is measured on the resident set of the process */
+void benchmarkReplicas(ostream &out, Parameters params, int iterations){
+	int maxReplicas = params.replicas > 1 ? params.replicas : std::max<int>(std::thread::hardware_concurrency(), 1);
+	vector<Mat> crops, batch;
+	double single = 0, singleMemory = 0;
+
+	randomCrops(params, 4 * params.maxBatchSize, crops);
+	batch.assign(crops.begin(), crops.begin() + params.maxBatchSize);
+
+	out << "replicas,split_images_per_s,concurrent_images_per_s,speedup,mb_per_replica" << endl;
+	for(int replicas = 1; ; replicas = std::min(2 * replicas, maxReplicas)){
+		params.replicas = replicas;
+		double before = residentMegabytes();
+		std::unique_ptr<Classifier> classifier = createClassifier(params);
+		double memory = residentMegabytes() - before;
+
+		double split = timeMilliseconds([&]{ classifier->ClassifyBatch(crops, NUM_CLASSES, 1); }, iterations);
+		double concurrent = timeMilliseconds([&]{
+			vector<std::thread> callers;
+			for(int i = 0; i < replicas; i++)
+				callers.push_back(std::thread([&]{ classifier->ClassifyBatch(batch, NUM_CLASSES, 1); }));
+			for(int i = 0; i < replicas; i++)
+				callers[i].join();
+		}, iterations);
+
+		if(replicas == 1){
+			single = crops.size() * 1000 / split;
+			singleMemory = memory;
+		}
+		out << replicas << "," << crops.size() * 1000 / split << "," << (double) replicas * batch.size() * 1000 / concurrent << ","
+			<< crops.size() * 1000 / split / single << "," << (replicas > 1 ? (memory - singleMemory) / (replicas - 1) : 0) << endl;
+		if(replicas == maxReplicas)
+			break;
+	}
+}
+
+int main(int argc, char **argv){
+
+	//Parameters
+	Parameters 	params;
+	string 		format,
+				output;
+	long 		maxFrames;
+
+	// Declare a group of options that will be
+	// allowed only on command line
+	po::options_description cmdline_options("Benchmark options");
+	cmdline_options.add_options()
+	("help,h", "Print help message")
+	("classification,c", "Enable classification mode")
+	("tracking,t", "Enable tracking mode")
+	("video,v", po::value<string>(&params.videoPath)->default_value(""), "Path of the recorded video to replay, or of a frame replay written by TrafficMonitoring --record-frames")
+	("format,f", po::value<string>(&format)->default_value("csv"), "Report format, csv or json")
+	("output,o", po::value<string>(&output)->default_value(""), "Report file, if not specified the report is written on the standard output")
+	("frames,n", po::value<long>(&maxFrames)->default_value(0), "Maximum number of frames to analyze, 0 for the whole video")
+	("preprocess", "Compare the fused preprocessing of the classifier with the reference one, at 114x114 and 227x227 inputs")
+	("assignment-bench", "Compare the greedy and the global assignment of the objects to the tracks, at 10, 50 and 200 objects per frame")
+	("subtractor-bench", "Compare the mixture subtractor with MOG2 at scaling factors 40, 80 and 120, on the video if given, otherwise on a synthetic scene")
+	("filter-bench", "Compare the blur and the closing of the foreground mask with the reference ones, with kernels of 5, 11, 21 and 41 pixels")
+	("detector-bench", "Compare the objects found by the connected components of the foreground mask with the ones of its contours, on the video if given, otherwise on a synthetic scene")
+	("reclassify-bench", "Compare the classifications per tracked object when each track is classified once and with the budgeted re-classification, on the video")
+	("engine-bench", "Compare the throughput and the predictions of the caffe, opencv and native backends on all the nets of data/nets, on crops of the video if given")
+	("startup-bench", "Compare the time to load the net of net_path from its Caffe files with each backend and from a bundle written by --compile-model")
+	("metrics-bench", "Measure the overhead of the metrics: a lap of a stage timer, an export, and the analysis of the video without and with them")
+	("motion-bench", "Compare the tracks without and with the motion model: identity switches on a synthetic scene of fast objects, classifications per tracked object on the video if given")
+	("change-bench", "Compare the analysis of a synthetic scene after a sudden change of its lighting without and with the change gate")
+	("replica-bench", "Measure the throughput of the classifier from 1 to the configured replicas of the network (to the cores if 1), on crops of the video if given");
+
+	// Configuration parameters can be overridden from the command line,
+	// so that different nets and scaling factors can be compared without editing Config.txt
+	po::options_description config_file_options = configFileOptions(params);
+	po::options_description overridable_options = configFileOptions(params);
+	cmdline_options.add(overridable_options);
+
+	po::variables_map vm;
+	try{
+		po::store(po::parse_command_line(argc, argv, cmdline_options),vm);
+
+		// --help option
+		if (vm.count("help")){
+			cout<< cmdline_options << endl;
+			return EXIT_SUCCESS;
+		}
+
+		po::store(po::parse_config_file<char>("Config.txt", config_file_options),vm);
+		po::notify(vm);
+
+		if(format.compare("csv") != 0 && format.compare("json") != 0)
+			throw po::error("the format must be csv or json");
+		if(params.videoPath.compare("") == 0 && !vm.count("preprocess") && !vm.count("assignment-bench") && !vm.count("subtractor-bench") && !vm.count("filter-bench") && !vm.count("detector-bench") && !vm.count("engine-bench") && !vm.count("startup-bench") && !vm.count("replica-bench") && !vm.count("change-bench") && !vm.count("motion-bench"))
+			throw po::error("the option '--video' is required");
+	}
+	catch(po::error& e){
+		cerr<< "ERROR: "<< e.what()<< endl;
+		cerr<< cmdline_options << endl;
+		return EXIT_FAILURE;
+	}
+	params.classification = vm.count("classification") > 0;
+	params.tracking = vm.count("tracking") > 0;
+	params.pipeline = false;
+	params.multiStream = false;
+	params.realTime = false;
+
+	std::ofstream file;
+	if(output.compare("") != 0){
+		file.open(output.c_str());
+		if(!file){
+			cerr << "ERROR! Unable to open " << output << endl;
+			return EXIT_FAILURE;
+		}
+	}
+	ostream &out = output.compare("") != 0 ? file : cout;
+
+	//Micro-benchmarks
+	if(vm.count("preprocess")){
+		benchmarkPreprocessing(out, params.sf, 8, 200);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("assignment-bench")){
+		benchmarkAssignment(out, params, 200);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("subtractor-bench")){
+		benchmarkSubtractors(out, params, maxFrames);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("filter-bench")){
+		return benchmarkFilter(out, params.sf, 100) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if(vm.count("detector-bench")){
+		benchmarkDetector(out, params, maxFrames);
+		return EXIT_SUCCESS;
+	}
+
+	if(vm.count("engine-bench")){
+		return benchmarkEngines(out, params, 5) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if(vm.count("startup-bench")){
+		benchmarkStartup(out, params, 5);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("motion-bench")){
+		benchmarkMotion(out, params, maxFrames);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("change-bench")){
+		benchmarkChangeGate(out, params, maxFrames);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("replica-bench")){
+		benchmarkReplicas(out, params, 5);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("metrics-bench")){
+		benchmarkMetrics(out, params, maxFrames);
+		return EXIT_SUCCESS;
+	}
+	if(vm.count("reclassify-bench")){
+		benchmarkReclassification(out, params, maxFrames);
+		return EXIT_SUCCESS;
+	}
+
+	Profiler profiler;
+	Tracker tracker = createTracker(params);
+	long frames;
+	double seconds;
+	benchmarkVideoStream(params, maxFrames, profiler, tracker, frames, seconds);
+
+	//Write the report
+	if(format.compare("json") == 0)
+		writeJSON(out, params, frames, seconds, profiler.summary());
+	else
+		writeCSV(out, params, frames, seconds, profiler.summary());
+
+	return EXIT_SUCCESS;
+}
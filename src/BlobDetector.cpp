@@ -0,0 +1,251 @@
+#include "../include/BlobDetector.hpp"
+#include <string.h>
+
+using namespace cv;
+
+/* True if any of the 8 bytes of the word is zero */
+static inline bool hasZeroByte(uint64_t word){
+	return ((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) != 0;
+}
+
+/* Root of the set of a run, halving the path on the way */
+static inline int findRoot(int *parents, int run){
+	while(parents[run] != run){
+		parents[run] = parents[parents[run]];
+		run = parents[run];
+	}
+	return run;
+}
+
+/* Join the sets of two runs. The root of a set is its first run in raster order */
+static inline void joinRuns(int *parents, int a, int b){
+	a = findRoot(parents, a);
+	b = findRoot(parents, b);
+	if(a < b)
+		parents[b] = a;
+	else if(b < a)
+		parents[a] = b;
+}
+
+/* Append the runs of foreground pixels of a row. Background and foreground are skipped 8 pixels at a time */
+static void findRuns(const uint8_t *row, int width, int y, std::vector<BlobRun> &runs){
+	uint64_t word;
+	int x = 0;
+
+	while(x < width){
+		while(x + 8 <= width && (memcpy(&word, row + x, 8), word == 0))
+			x += 8;
+		while(x < width && row[x] == 0)
+			x++;
+		if(x == width)
+			break;
+
+		BlobRun run;
+		run.y = y;
+		run.start = x;
+		while(x + 8 <= width && (memcpy(&word, row + x, 8), !hasZeroByte(word)))
+			x += 8;
+		while(x < width && row[x] != 0)
+			x++;
+		run.end = x;
+		runs.push_back(run);
+	}
+}
+
+/* Join the runs of a row with the runs of the row below that touch them, diagonally too (8-connectivity).
+ * The indices of the runs in the union-find start at aboveBase and belowBase */
+static void joinRows(const BlobRun *above, int aboveCount, int aboveBase, const BlobRun *below, int belowCount, int belowBase, int *parents){
+	int i = 0, j = 0;
+
+	while(i < aboveCount && j < belowCount){
+		if(above[i].start <= below[j].end && below[j].start <= above[i].end)
+			joinRuns(parents, aboveBase + i, belowBase + j);
+		//The run that ends first cannot touch the following runs of the other row
+		if(above[i].end < below[j].end)
+			i++;
+		else
+			j++;
+	}
+}
+
+/* Labeling of a range of stripes, run by a worker thread */
+class StripeLabeling : public ParallelLoopBody {
+
+	private:
+		BlobDetector &	detector_;
+		const Mat &		mask_;
+
+	public:
+		StripeLabeling(BlobDetector &detector, const Mat &mask) : detector_(detector), mask_(mask) {}
+
+		void operator()(const Range &range) const{
+			for(int stripe = range.start; stripe < range.end; stripe++)
+				detector_.labelStripe(mask_, stripe, stripe * BLOB_STRIPE_ROWS, std::min(mask_.rows, (stripe + 1) * BLOB_STRIPE_ROWS));
+		}
+};
+
+/* Find the runs of the rows of a stripe and join the ones that touch */
+void BlobDetector::labelStripe(const Mat &mask, int stripe, int firstRow, int lastRow){
+	std::vector<BlobRun> &runs = stripeRuns_[stripe];
+	std::vector<int> &parents = stripeParents_[stripe];
+	int above = 0, aboveEnd = 0;	//Runs of the previous row
+
+	runs.clear();
+	for(int y = firstRow; y < lastRow; y++){
+		int begin = runs.size();
+		findRuns(mask.ptr<uint8_t>(y), mask.cols, y, runs);
+		int end = runs.size();
+
+		parents.resize(end);
+		for(int i = begin; i < end; i++)
+			parents[i] = i;
+		//Rows without runs have nothing to join
+		if(y > firstRow && aboveEnd > above && end > begin)
+			joinRows(runs.data() + above, aboveEnd - above, above, runs.data() + begin, end - begin, begin, parents.data());
+
+		above = begin;
+		aboveEnd = end;
+	}
+	parents.resize(runs.size());
+}
+
+/* Check if the background pixel start is enclosed by foreground pixels inside the bounds, i.e. if the background pixels
+ * 4-connected to it never reach the edge of the bounds */
+bool BlobDetector::enclosed(const Mat &mask, Point start, Rect bounds){
+	int width = bounds.width;
+	visited_.assign(bounds.area(), 0);
+	queue_.clear();
+	queue_.push_back((start.y - bounds.y) * width + start.x - bounds.x);
+	visited_[queue_.back()] = 1;
+
+	for(unsigned int i = 0; i < queue_.size(); i++){
+		int x = queue_[i] % width, y = queue_[i] / width;
+		if(x == 0 || y == 0 || x == width - 1 || y == bounds.height - 1)
+			return false;
+
+		int neighbors[4] = {queue_[i] - 1, queue_[i] + 1, queue_[i] - width, queue_[i] + width};
+		for(int n = 0; n < 4; n++){
+			int nx = neighbors[n] % width, ny = neighbors[n] / width;
+			if(!visited_[neighbors[n]] && mask.ptr<uint8_t>(bounds.y + ny)[bounds.x + nx] == 0){
+				visited_[neighbors[n]] = 1;
+				queue_.push_back(neighbors[n]);
+			}
+		}
+	}
+	return true;
+}
+
+/* Remove the components inside a hole of another one. Such a component lies strictly inside the bounding box of the other,
+ * and the background at the left of its leftmost pixel cannot reach the edge of that box. Every hole is surrounded by a
+ * single component (8-connected foreground, 4-connected background), so the flood fill can stop at the bounding box */
+void BlobDetector::removeNested(const Mat &mask, std::vector<ForegroundBlob> &blobs){
+	order_.resize(blobs.size());
+	for(unsigned int i = 0; i < blobs.size(); i++)
+		order_[i] = i;
+	std::sort(order_.begin(), order_.end(), [&](int a, int b){ return blobs[a].box.x < blobs[b].box.x; });
+
+	labels_.assign(blobs.size(), 0);	//Nested components
+	for(unsigned int d = 0; d < order_.size(); d++){
+		const Rect outer = blobs[order_[d]].box;
+		//Candidates start to the right of the left side of the outer box
+		for(unsigned int c = d + 1; c < order_.size() && blobs[order_[c]].box.x < outer.x + outer.width - 1; c++){
+			const Rect inner = blobs[order_[c]].box;
+			if(labels_[order_[c]] || inner.x <= outer.x || inner.y <= outer.y || inner.br().x >= outer.br().x || inner.br().y >= outer.br().y)
+				continue;
+			if(enclosed(mask, Point(inner.x - 1, leftRows_[order_[c]]), outer))
+				labels_[order_[c]] = 1;
+		}
+	}
+
+	unsigned int kept = 0;
+	for(unsigned int i = 0; i < blobs.size(); i++){
+		if(!labels_[i]){
+			blobs[kept] = blobs[i];
+			sums_[2 * kept] = sums_[2 * i];
+			sums_[2 * kept + 1] = sums_[2 * i + 1];
+			kept++;
+		}
+	}
+	blobs.resize(kept);
+}
+
+/* Find the connected components of the mask. Their coordinates are moved by offset, typically the position of the mask
+ * in a larger image. The components are given in the same order as findContours does: by their first pixel, from the
+ * last one in raster order. They are valid until the next call */
+const std::vector<ForegroundBlob> &BlobDetector::detect(const Mat &mask, Point offset){
+	std::vector<ForegroundBlob> &blobs = blobs_;
+	CV_Assert(mask.type() == CV_8U);
+	int stripes = (mask.rows + BLOB_STRIPE_ROWS - 1) / BLOB_STRIPE_ROWS;
+
+	stripeRuns_.resize(stripes);
+	stripeParents_.resize(stripes);
+	parallel_for_(Range(0, stripes), StripeLabeling(*this, mask));
+
+	//Union-find of all the runs, each stripe after the previous one
+	std::vector<int> bases(stripes + 1, 0);
+	parents_.clear();
+	for(int s = 0; s < stripes; s++){
+		bases[s] = parents_.size();
+		for(unsigned int i = 0; i < stripeParents_[s].size(); i++)
+			parents_.push_back(stripeParents_[s][i] + bases[s]);
+	}
+	bases[stripes] = parents_.size();
+
+	//Join the runs of the last row of each stripe with the ones of the first row of the next stripe
+	for(int s = 1; s < stripes; s++){
+		const std::vector<BlobRun> &above = stripeRuns_[s - 1];
+		const std::vector<BlobRun> &below = stripeRuns_[s];
+		int border = s * BLOB_STRIPE_ROWS;
+		int aboveFirst = above.size(), belowCount = 0;
+		while(aboveFirst > 0 && above[aboveFirst - 1].y == border - 1)
+			aboveFirst--;
+		while(belowCount < (int)below.size() && below[belowCount].y == border)
+			belowCount++;
+		if(aboveFirst < (int)above.size() && belowCount > 0)
+			joinRows(above.data() + aboveFirst, above.size() - aboveFirst, bases[s - 1] + aboveFirst, below.data(), belowCount, bases[s], parents_.data());
+	}
+
+	//Sum the statistics of each component over its runs. A component is numbered when its root, its first run, is met
+	blobs.clear();
+	sums_.clear();
+	leftRows_.clear();
+	labels_.assign(parents_.size(), -1);
+	for(int s = 0; s < stripes; s++){
+		const std::vector<BlobRun> &runs = stripeRuns_[s];
+		for(unsigned int i = 0; i < runs.size(); i++){
+			const BlobRun &run = runs[i];
+			int root = findRoot(parents_.data(), bases[s] + i);
+			int length = run.end - run.start;
+			Rect segment(run.start, run.y, length, 1);
+
+			if(labels_[root] < 0){
+				labels_[root] = blobs.size();
+				ForegroundBlob blob;
+				blob.box = segment;
+				blob.area = 0;
+				blobs.push_back(blob);
+				sums_.push_back(0);
+				sums_.push_back(0);
+				leftRows_.push_back(run.y);
+			}
+
+			int label = labels_[root];
+			ForegroundBlob &blob = blobs[label];
+			if(run.start < blob.box.x)
+				leftRows_[label] = run.y;
+			blob.box |= segment;
+			blob.area += length;
+			sums_[2 * label] += (int64_t)length * (run.start + run.end - 1) / 2;
+			sums_[2 * label + 1] += (int64_t)length * run.y;
+		}
+	}
+
+	removeNested(mask, blobs);
+
+	for(unsigned int i = 0; i < blobs.size(); i++){
+		blobs[i].box += offset;
+		blobs[i].centroid = Point2f(sums_[2 * i] / (double)blobs[i].area + offset.x, sums_[2 * i + 1] / (double)blobs[i].area + offset.y);
+	}
+	std::reverse(blobs.begin(), blobs.end());
+	return blobs;
+}
@@ -0,0 +1,90 @@
+#include "../include/CaffeEngine.hpp"
+
+using namespace caffe;
+
+/* Load the network once per batch size */
+CaffeEngine::CaffeEngine(const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes, bool use_GPU)
+	: sizes_(batchSizes), model_file_(model_file) {
+
+	if (use_GPU)
+		Caffe::set_mode(Caffe::GPU);
+	else
+		Caffe::set_mode(Caffe::CPU);
+
+	/* Load the network. */
+	nets_.push_back(caffe::shared_ptr<Net<float> >(new Net<float>(model_file, TEST)));
+	nets_[0]->CopyTrainedLayersFrom(trained_file);
+
+	CHECK_EQ(nets_[0]->num_inputs(), 1) << "Network should have exactly one input.";
+	CHECK_EQ(nets_[0]->num_outputs(), 1) << "Network should have exactly one output.";
+
+	/* One net per batch size, all sharing the weights of the first one. */
+	for (size_t i = 1; i < sizes_.size(); ++i) {
+		nets_.push_back(caffe::shared_ptr<Net<float> >(new Net<float>(model_file, TEST)));
+		nets_[i]->ShareTrainedLayersWith(nets_[0].get());
+	}
+	shape();
+}
+
+/* The nets of the replica share the weights of the nets of the source, only their activations take memory */
+CaffeEngine::CaffeEngine(const CaffeEngine &source)
+	: InferenceEngine(), sizes_(source.sizes_), model_file_(source.model_file_) {
+
+	for (size_t i = 0; i < sizes_.size(); ++i) {
+		nets_.push_back(caffe::shared_ptr<Net<float> >(new Net<float>(model_file_, TEST)));
+		nets_[i]->ShareTrainedLayersWith(source.nets_[0].get());
+	}
+	shape();
+}
+
+/* Each net is reshaped once here, so that a call only pays for the forward pass
+ * whatever the number of images, and it is run once to warm it up. */
+void CaffeEngine::shape() {
+	caffe::Blob<float>* input_layer = nets_[0]->input_blobs()[0];
+	int channels = input_layer->channels();
+	int height = input_layer->height();
+	int width = input_layer->width();
+
+	for (size_t i = 0; i < sizes_.size(); ++i) {
+		nets_[i]->input_blobs()[0]->Reshape(sizes_[i], channels, height, width);
+		nets_[i]->Reshape();
+		nets_[i]->Forward();
+	}
+}
+
+/* Net shaped for the given batch size */
+Net<float> *CaffeEngine::net(int size) const {
+	for (size_t i = 0; i < sizes_.size(); ++i)
+		if (sizes_[i] == size)
+			return nets_[i].get();
+	LOG(FATAL) << "No net shaped for batches of " << size << " images.";
+	return NULL;
+}
+
+int CaffeEngine::inputChannels() const {
+	return nets_[0]->input_blobs()[0]->channels();
+}
+
+cv::Size CaffeEngine::inputGeometry() const {
+	caffe::Blob<float>* input_layer = nets_[0]->input_blobs()[0];
+	return cv::Size(input_layer->width(), input_layer->height());
+}
+
+int CaffeEngine::outputSize() const {
+	return nets_[0]->output_blobs()[0]->channels();
+}
+
+/* The preprocessing writes the planes of each image directly to the input layer of the network */
+float *CaffeEngine::input(int size) {
+	return net(size)->input_blobs()[0]->mutable_cpu_data();
+}
+
+const float *CaffeEngine::forward(int size) {
+	Net<float> *batchNet = net(size);
+	batchNet->Forward();
+	return batchNet->output_blobs()[0]->cpu_data();
+}
+
+std::unique_ptr<InferenceEngine> CaffeEngine::replicate() const {
+	return std::unique_ptr<InferenceEngine>(new CaffeEngine(*this));
+}
@@ -0,0 +1,40 @@
+#include "../include/ChangeGate.hpp"
+#include <stdint.h>
+#include <string.h>
+
+ChangeGate::ChangeGate(float threshold, double learningRate) : threshold_(threshold), recovery_(0), learningRate_(learningRate) {}
+
+/* A change restarts the recovery, which lasts until CHANGE_RECOVERY_FRAMES frames have passed since the last one */
+bool ChangeGate::changed(const cv::Mat &mask){
+	if(threshold_ >= 1)
+		return false;
+	if(foregroundRatio(mask) > threshold_){
+		recovery_ = CHANGE_RECOVERY_FRAMES;
+		return true;
+	}
+	if(recovery_ > 0)
+		recovery_--;
+	return false;
+}
+
+/* The foreground is 255 and the background 0 (a shadow, 127, counts as background): the top bit of each byte
+ * tells them apart, so a popcount of the top bits counts eight pixels at once */
+float ChangeGate::foregroundRatio(const cv::Mat &mask){
+	const uint64_t topBits = 0x8080808080808080ULL;
+	long foreground = 0, sampled = 0;
+
+	CV_Assert(mask.type() == CV_8U);
+	for(int y = 0; y < mask.rows; y += CHANGE_SAMPLE_ROWS){
+		const uint8_t *row = mask.ptr<uint8_t>(y);
+		int x = 0;
+		for(; x <= mask.cols - 8; x += 8){
+			uint64_t pixels;
+			memcpy(&pixels, row + x, 8);
+			foreground += __builtin_popcountll(pixels & topBits);
+		}
+		for(; x < mask.cols; x++)
+			foreground += row[x] >> 7;
+		sampled += mask.cols;
+	}
+	return sampled > 0 ? (float) foreground / sampled : 0;
+}
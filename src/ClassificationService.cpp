@@ -0,0 +1,139 @@
+
+#include "../include/ClassificationService.hpp"
+
+/* Class constructor, the worker threads start immediately */
+ClassificationService::ClassificationService(Classifier &classifier, int num_classes, int max_batch_size, double max_wait_ms)
+	: classifier_(classifier),
+	  num_classes_(num_classes),
+	  max_batch_size_(max_batch_size > 0 ? max_batch_size : 1),
+	  max_wait_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(max_wait_ms))),
+	  stopped_(false),
+	  batch_sizes_(max_batch_size_ + 1, 0),
+	  pendingProbe_("tm_classification_pending", "", "Images waiting for their batch", false, [this]{ std::lock_guard<std::mutex> lock(mutex_); return (double) pending_.size(); }) {
+	for(int i = 0; i < classifier_.replicas(); i++)
+		workers_.push_back(std::thread(&ClassificationService::run, this));
+}
+
+/* Class destructor, the images already submitted are classified before returning */
+ClassificationService::~ClassificationService(){
+	stop();
+}
+
+/* Queue an image for classification */
+PendingPrediction ClassificationService::submit(const Mat &image){
+	return submitBatch(vector<Mat>(1, image)).at(0);
+}
+
+/* Queue several images at once, so that they end up in the same batch whenever possible */
+vector<PendingPrediction> ClassificationService::submitBatch(const vector<Mat> &images){
+	vector<PendingPrediction> results;
+	Clock::time_point now = Clock::now();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for(unsigned int i = 0; i < images.size(); i++){
+		Request request;
+		request.image = images[i];
+		request.arrival = now;
+		results.push_back(request.result.get_future().share());
+		if(stopped_)
+			request.result.set_exception(std::make_exception_ptr(std::runtime_error("classification service stopped")));
+		else
+			pending_.push_back(std::move(request));
+	}
+	available_.notify_one();
+	return results;
+}
+
+/* Classify the images and wait for the predictions */
+vector< vector<Prediction> > ClassificationService::classify(const vector<Mat> &images){
+	vector<PendingPrediction> pending = submitBatch(images);
+	vector< vector<Prediction> > predictions;
+
+	for(unsigned int i = 0; i < pending.size(); i++)
+		predictions.push_back(pending[i].get());
+	return predictions;
+}
+
+/* Classify the images still pending and stop the worker threads */
+void ClassificationService::stop(){
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopped_ = true;
+		available_.notify_all();
+	}
+	for(unsigned int i = 0; i < workers_.size(); i++)
+		if(workers_[i].joinable())
+			workers_[i].join();
+}
+
+/* Number of batches run so far for each batch size (the index is the size) */
+vector<long> ClassificationService::batchSizes(){
+	std::lock_guard<std::mutex> lock(mutex_);
+	return batch_sizes_;
+}
+
+/* Print the distribution of the batch sizes achieved */
+void ClassificationService::printStatistics(ostream &out){
+	vector<long> sizes = batchSizes();
+	long batches = 0, images = 0;
+
+	for(unsigned int i = 0; i < sizes.size(); i++){
+		batches += sizes[i];
+		images += sizes[i] * i;
+	}
+	out << "Classification batches: " << batches << ", images: " << images
+		<< ", mean batch size: " << (batches > 0 ? (double) images / batches : 0) << endl;
+	for(unsigned int i = 1; i < sizes.size(); i++)
+		if(sizes[i] > 0)
+			out << "  batch size " << i << ": " << sizes[i] << endl;
+}
+
+/* Worker loop: wait for a full batch or for the deadline of the oldest image, then classify */
+void ClassificationService::run(){
+	while(true){
+		vector<Request> batch;
+		vector<Mat> images;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while(true){
+				available_.wait(lock, [this]{ return stopped_ || !pending_.empty(); });
+				if(pending_.empty())
+					return;
+
+				//Wait for more images until the batch is full or the oldest image reaches its deadline
+				Clock::time_point deadline = pending_.front().arrival + max_wait_;
+				available_.wait_until(lock, deadline, [this]{ return stopped_ || pending_.size() >= max_batch_size_; });
+
+				//Another worker may have taken the images meanwhile: wait again for new ones, with the deadline of the oldest
+				if(pending_.empty())
+					continue;
+				if(stopped_ || pending_.size() >= max_batch_size_ || Clock::now() >= pending_.front().arrival + max_wait_)
+					break;
+			}
+
+			size_t size = std::min(pending_.size(), max_batch_size_);
+			for(size_t i = 0; i < size; i++){
+				images.push_back(pending_.front().image);
+				batch.push_back(std::move(pending_.front()));
+				pending_.pop_front();
+			}
+			batch_sizes_[size]++;
+
+			//The images left are for the next worker
+			if(!pending_.empty())
+				available_.notify_one();
+		}
+		metrics.observe(BATCH_SIZE, images.size());
+
+		try{
+			vector< vector<Prediction> > predictions = classifier_.ClassifyBatch(images, num_classes_, 1);
+			for(unsigned int i = 0; i < batch.size(); i++)
+				batch[i].result.set_value(predictions.at(i));
+		}
+		catch(...){
+			for(unsigned int i = 0; i < batch.size(); i++)
+				batch[i].result.set_exception(std::current_exception());
+		}
+	}
+}
@@ -4,6 +4,10 @@
  */
 
 #include "../include/Classifier.hpp"
+#include <glog/logging.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 Classes strToEnum(string s){
 
@@ -29,53 +33,109 @@ Classes strToEnum(string s){
 	return other;
 }
 
+string enumToStr(Classes c){
+	static const char * names[] = {"car", "person", "bus", "truck", "van", "motorbike", "bicycle", "tram", "background", "other"};
+
+	return names[c];
+}
+
 /* Class constructor */
 Classifier::Classifier(const string& model_file,
                        const string& trained_file,
                        const string& mean_file,
                        const string& label_file,
                        const bool use_GPU,
-					   const int batch_size) {
+					   const int max_batch_size,
+					   const string& backend,
+					   const int replicas) {
 
-	if (use_GPU)
-		Caffe::set_mode(Caffe::GPU);
-	else
-		Caffe::set_mode(Caffe::CPU);
+	SetBuckets(max_batch_size);
+
+	/* Load the network, once per bucket. */
+	engines_.push_back(createInferenceEngine(backend, model_file, trained_file, buckets_, use_GPU));
 
-	/* Set batchsize */
-	batch_size_ = batch_size;
+	/* Load the binaryproto mean file and the labels. */
+	mean_values_ = readMeanValues(mean_file);
+	labels_ = readLabels(label_file);
+	CheckNet();
+	Replicate(replicas);
+}
+
+/* Load the network, the mean values and the labels from a bundle written by --compile-model, for the native backend */
+Classifier::Classifier(const string& bundle_file, const int max_batch_size, const int replicas) {
 
-	/* Load the network. */
-	net_.reset(new caffe::Net<float>(model_file, TEST));
-	net_->CopyTrainedLayersFrom(trained_file);
+	SetBuckets(max_batch_size);
 
-	CHECK_EQ(net_->num_inputs(), 1) << "Network should have exactly one input.";
-	CHECK_EQ(net_->num_outputs(), 1) << "Network should have exactly one output.";
+	bundle_.reset(new ModelBundle(bundle_file));
+	engines_.push_back(std::unique_ptr<InferenceEngine>(new NativeEngine(bundle_->net(), bundle_->parameters(), buckets_)));
+	mean_values_ = bundle_->meanValues();
+	labels_ = bundle_->labels();
+	CheckNet();
+	Replicate(replicas);
+}
+
+/* Batch sizes the network is shaped for: powers of two up to the maximum batch size */
+void Classifier::SetBuckets(int max_batch_size) {
+	profiler_ = NULL;
+	for (int size = 1; size < max_batch_size; size *= 2)
+		buckets_.push_back(size);
+	buckets_.push_back(std::max(max_batch_size, 1));
+}
 
-	caffe::Blob<float>* input_layer = net_->input_blobs()[0];
-	num_channels_ = input_layer->channels();
+/* Check the input layer against the mean values, and the output layer against the labels */
+void Classifier::CheckNet() {
+	const InferenceEngine* engine = engines_[0].get();
+	num_channels_ = engine->inputChannels();
 	CHECK(num_channels_ == 3 || num_channels_ == 1)
 		<< "Input layer should have 1 or 3 channels.";
-	input_geometry_ = cv::Size(input_layer->width(), input_layer->height());
+	input_geometry_ = engine->inputGeometry();
 
-	/* Load the binaryproto mean file. */
-	SetMean(mean_file);
+	CHECK_EQ((int) mean_values_.size(), num_channels_)
+		<< "Number of channels of mean file doesn't match input layer.";
+	CHECK_EQ((int) labels_.size(), engine->outputSize())
+		<< "Number of labels is different from the output layer dimension.";
+}
 
-	/* Load labels. */
-	std::ifstream labels(label_file.c_str());
-	CHECK(labels) << "Unable to open labels file " << label_file;
-	string line;
-	while (std::getline(labels, line))
-		labels_.push_back(string(line));
+/* Add the replicas of the network loaded, all idle. The first one is handed out first */
+void Classifier::Replicate(int replicas) {
+	for (int i = 1; i < replicas; ++i)
+		engines_.push_back(engines_[0]->replicate());
+	for (int i = engines_.size() - 1; i >= 0; --i)
+		idle_.push_back(i);
+}
 
-	caffe::Blob<float>* output_layer = net_->output_blobs()[0];
-	CHECK_EQ(labels_.size(), output_layer->channels())
-		<< "Number of labels is different from the output layer dimension.";
+/* Take up to the wanted number of idle replicas, at least one: wait for one if they are all busy */
+std::vector<int> Classifier::AcquireReplicas(size_t wanted) {
+	std::unique_lock<std::mutex> lock(replicaMutex_);
+	replicaReleased_.wait(lock, [this]{ return !idle_.empty(); });
+
+	std::vector<int> replicas;
+	while (!idle_.empty() && replicas.size() < std::max<size_t>(wanted, 1)) {
+		replicas.push_back(idle_.back());
+		idle_.pop_back();
+	}
+	return replicas;
+}
+
+void Classifier::ReleaseReplicas(const std::vector<int>& replicas) {
+	if (replicas.empty())
+		return;
+	std::lock_guard<std::mutex> lock(replicaMutex_);
+	idle_.insert(idle_.end(), replicas.rbegin(), replicas.rend());
+	replicaReleased_.notify_all();
 }
 
-/* Change batch size on-fly */
-void Classifier::setBatchSize(int batch_size){
-	batch_size_ = batch_size;
+/* Index of the smallest bucket that holds the given number of images */
+int Classifier::BucketIndex(int num) const {
+	for (size_t i = 0; i < buckets_.size(); ++i)
+		if (buckets_[i] >= num)
+			return i;
+	return buckets_.size() - 1;
+}
+
+/* Measure preprocessing, forward and argmax of each batch */
+void Classifier::setProfiler(Profiler *profiler){
+	profiler_ = profiler;
 }
 
 /* Compare classification based on prob */
@@ -98,8 +158,9 @@ std::vector<int> Classifier::Argmax(const std::vector<float>& v, int N) {
 }
 
 /* Return the top N predictions. */
-std::vector< vector<Prediction> > Classifier::ClassifyBatch(const vector< cv::Mat > imgs, int num_classes, int N){
+std::vector< vector<Prediction> > Classifier::ClassifyBatch(const vector< cv::Mat >& imgs, int num_classes, int N){
     std::vector<float> output_batch = PredictBatch(imgs);
+    StageTimer timer(profiler_);
     std::vector< std::vector<Prediction> > predictions;
     N = min<int>(num_classes, N);
     for(unsigned int j = 0; j < imgs.size(); j++){
@@ -112,128 +173,247 @@ std::vector< vector<Prediction> > Classifier::ClassifyBatch(const vector< cv::Ma
         }
         predictions.push_back(std::vector<Prediction>(prediction_single));
     }
+    timer.lap("classify_argmax");
     return predictions;
 }
 
-/* Load the mean file in binaryproto format. */
-void Classifier::SetMean(const string& mean_file) {
-	BlobProto blob_proto;
-	ReadProtoFromBinaryFileOrDie(mean_file.c_str(), &blob_proto);
-
-	/* Convert from BlobProto to Blob<float> */
-	caffe::Blob<float> mean_blob;
-	mean_blob.FromProto(blob_proto);
-	CHECK_EQ(mean_blob.channels(), num_channels_)
-		<< "Number of channels of mean file doesn't match input layer.";
-
-	/* The format of the mean file is planar 32-bit float BGR or grayscale. */
-	std::vector<cv::Mat> channels;
-	float* data = mean_blob.mutable_cpu_data();
-	for (int i = 0; i < num_channels_; ++i) {
-		/* Extract an individual channel. */
-		cv::Mat channel(mean_blob.height(), mean_blob.width(), CV_32FC1, data);
-		channels.push_back(channel);
-		data += mean_blob.height() * mean_blob.width();
-	}
-
-	/* Merge the separate channels into a single image. */
-	cv::Mat mean;
-	cv::merge(channels, mean);
-
-	/* Compute the global mean pixel value and create a mean image
-	* filled with this value. */
-	cv::Scalar channel_mean = cv::mean(mean);
-	mean_ = cv::Mat(input_geometry_, mean.type(), channel_mean);
+/* Sub-batches of a batch, each one forwarded by its own replica of the network */
+class ReplicaBody : public cv::ParallelLoopBody {
+	public:
+		ReplicaBody(Classifier& classifier, const vector<cv::Mat>& imgs, const std::vector<int>& replicas,
+		            size_t part, float* output)
+			: classifier_(classifier), imgs_(imgs), replicas_(replicas), part_(part), output_(output) {}
+
+		virtual void operator()(const cv::Range& range) const {
+			for (int i = range.start; i < range.end; ++i) {
+				size_t begin = i * part_;
+				size_t end = std::min(begin + part_, imgs_.size());
+				vector<cv::Mat> chunk(imgs_.begin() + begin, imgs_.begin() + end);
+				InferenceEngine& engine = *classifier_.engines_[replicas_[i]];
+
+				classifier_.PredictChunk(engine, chunk, output_ + begin * engine.outputSize());
+			}
+		}
+
+	private:
+		Classifier& 				classifier_;
+		const vector<cv::Mat>& 		imgs_;
+		const std::vector<int>& 	replicas_;
+		size_t 						part_;		//Images of each sub-batch, but the last one
+		float* 						output_;
+};
+
+/* Forward a batch of images through the net, split among the replicas idle when it arrives. The sub-batches
+ * are as large as a bucket, so that only the last one is padded, and the replicas left without any images
+ * are released at once for the other callers */
+std::vector< float > Classifier::PredictBatch(const vector< cv::Mat >& imgs) {
+	std::vector<float> output(imgs.size() * engines_[0]->outputSize());
+	if (imgs.empty())
+		return output;
+
+	std::vector<int> replicas = AcquireReplicas(imgs.size());
+	size_t part = (imgs.size() + replicas.size() - 1) / replicas.size();
+	if (part <= (size_t) buckets_.back())
+		part = buckets_[BucketIndex(part)];
+	size_t parts = (imgs.size() + part - 1) / part;
+	ReleaseReplicas(std::vector<int>(replicas.begin() + parts, replicas.end()));
+	replicas.resize(parts);
+
+	if (parts == 1)
+		PredictChunk(*engines_[replicas[0]], imgs, &output[0]);
+	else
+		cv::parallel_for_(cv::Range(0, parts), ReplicaBody(*this, imgs, replicas, part, &output[0]));
+	ReleaseReplicas(replicas);
+	return output;
 }
 
-/* Forward a batch of images through the net*/
-std::vector< float > Classifier::PredictBatch(const vector< cv::Mat > imgs) {
-	caffe::Blob<float>* input_layer = net_->input_blobs()[0];
+/* Forward images through a replica of the net, writing their outputs one after the other. The images are
+ * padded up to the nearest bucket, larger batches are split into chunks of the largest one */
+void Classifier::PredictChunk(InferenceEngine& engine, const vector< cv::Mat >& imgs, float* output) {
+	StageTimer timer(profiler_);
 
-	input_layer->Reshape(batch_size_, num_channels_,
-						input_geometry_.height,
-						input_geometry_.width);
+	for (size_t start = 0; start < imgs.size(); start += buckets_.back()) {
+		size_t num = std::min(imgs.size() - start, (size_t) buckets_.back());
+		int bucket = buckets_[BucketIndex(num)];
+		vector<cv::Mat> chunk(imgs.begin() + start, imgs.begin() + start + num);
 
-	/* Forward dimension change to all layers. */
-	net_->Reshape();
+		/* The preprocessing writes the planes of each image directly
+		 * to the input of the engine. */
+		PreprocessBatch(chunk, input_geometry_, num_channels_, mean_values_, engine.input(bucket));
+		timer.lap("classify_preprocess");
 
-	std::vector< std::vector<cv::Mat> > input_batch;
-	WrapBatchInputLayer(&input_batch);
+		const float* begin = engine.forward(bucket);
 
-	PreprocessBatch(imgs, &input_batch);
+		/* Copy the output layer after the outputs of the previous chunks */
+		output = std::copy(begin, begin + engine.outputSize()*num, output);
+		timer.lap("classify_forward");
+	}
+}
 
-	net_->Forward();
+/* Horizontal step of the bilinear resize: interpolate a row of the image
+ * and store it as separate planes of floats (one per channel). The source
+ * columns are not contiguous, so their pixels are loaded one by one, then
+ * four output columns are converted and interpolated together. */
+static void InterpolateRow(const uchar* src, int cn, const int* xofs0, const int* xofs1,
+                           const float* xalpha, int width, float* dst) {
+	for (int c = 0; c < cn; ++c) {
+		const uchar* s = src + c;
+		float* plane = dst + c * width;
+		int x = 0;
+#if defined(__SSE2__)
+		for (; x <= width - 4; x += 4) {
+			__m128 p0 = _mm_cvtepi32_ps(_mm_setr_epi32(s[xofs0[x]], s[xofs0[x + 1]], s[xofs0[x + 2]], s[xofs0[x + 3]]));
+			__m128 p1 = _mm_cvtepi32_ps(_mm_setr_epi32(s[xofs1[x]], s[xofs1[x + 1]], s[xofs1[x + 2]], s[xofs1[x + 3]]));
+			__m128 alpha = _mm_loadu_ps(xalpha + x);
+			_mm_storeu_ps(plane + x, _mm_add_ps(p0, _mm_mul_ps(_mm_sub_ps(p1, p0), alpha)));
+		}
+#endif
+		for (; x < width; ++x) {
+			float p0 = s[xofs0[x]];
+			float p1 = s[xofs1[x]];
+			plane[x] = p0 + (p1 - p0) * xalpha[x];
+		}
+	}
+}
 
-	/* Copy the output layer to a std::vector */
-	caffe::Blob<float>* output_layer = net_->output_blobs()[0];
-	const float* begin = output_layer->cpu_data();
-	const float* end = begin + output_layer->channels()*imgs.size();
-	return std::vector<float>(begin, end);
+/* Vertical step of the bilinear resize, fused with the mean subtraction:
+ * dst = row0 + (row1 - row0) * beta - mean */
+static void BlendRows(const float* row0, const float* row1, float beta, float mean,
+                      int width, float* dst) {
+	int x = 0;
+#if defined(__SSE2__)
+	__m128 vbeta = _mm_set1_ps(beta);
+	__m128 vmean = _mm_set1_ps(mean);
+	for (; x <= width - 4; x += 4) {
+		__m128 r0 = _mm_loadu_ps(row0 + x);
+		__m128 r1 = _mm_loadu_ps(row1 + x);
+		__m128 v = _mm_add_ps(r0, _mm_mul_ps(_mm_sub_ps(r1, r0), vbeta));
+		_mm_storeu_ps(dst + x, _mm_sub_ps(v, vmean));
+	}
+#endif
+	for (; x < width; ++x)
+		dst[x] = row0[x] + (row1[x] - row0[x]) * beta - mean;
 }
 
-/* Wrap the input layer of the network in separate cv::Mat objects
- * (one per channel). This way we save one memcpy operation and we
- * don't need to rely on cudaMemcpy2D. The last preprocessing
- * operation will write the separate channels directly to the input
- * layer. */
-void Classifier::WrapBatchInputLayer(std::vector<std::vector<cv::Mat> > *input_batch){
-    caffe::Blob<float>* input_layer = net_->input_blobs()[0];
+/* Resize an 8-bit image to the input geometry (bilinear, same sampling
+ * as cv::resize), convert it to float, subtract the mean of each channel
+ * and write it as planes (CHW), all in a single pass over the image.
+ * Only two rows of floats per channel are kept, in buffers owned by the
+ * calling thread, so no memory is allocated once they have grown. */
+void Classifier::PreprocessImage(const cv::Mat& img, cv::Size geometry,
+                                 const std::vector<float>& mean, float* output) {
+	CHECK_EQ(img.depth(), CV_8U) << "Input images should be 8-bit.";
+	const int cn = img.channels();
+	const int width = geometry.width;
+	const int height = geometry.height;
+	const float scale_x = (float) img.cols / width;
+	const float scale_y = (float) img.rows / height;
+
+	static thread_local std::vector<int> xofs0, xofs1;
+	static thread_local std::vector<float> xalpha, rows;
+	xofs0.resize(width);
+	xofs1.resize(width);
+	xalpha.resize(width);
+	rows.resize(2 * cn * width);
+
+	/* Source columns and weights, shared by all the rows */
+	for (int x = 0; x < width; ++x) {
+		float fx = (x + 0.5f) * scale_x - 0.5f;
+		int sx = (int) std::floor(fx);
+		fx -= sx;
+		if (sx < 0) {
+			sx = 0;
+			fx = 0;
+		}
+		if (sx >= img.cols - 1) {
+			sx = img.cols - 1;
+			fx = 0;
+		}
+		xofs0[x] = sx * cn;
+		xofs1[x] = std::min(sx + 1, img.cols - 1) * cn;
+		xalpha[x] = fx;
+	}
 
-    int width = input_layer->width();
-    int height = input_layer->height();
-    int num = input_layer->num();
-    float* input_data = input_layer->mutable_cpu_data();
-    for ( int j = 0; j < num; j++){
-        vector<cv::Mat> input_channels;
-        for (int i = 0; i < input_layer->channels(); ++i){
-          cv::Mat channel(height, width, CV_32FC1, input_data);
-          input_channels.push_back(channel);
-          input_data += width * height;
-        }
-		input_batch -> push_back(vector<cv::Mat>(input_channels));
+	float* row0 = &rows[0];
+	float* row1 = &rows[cn * width];
+	int cached0 = -1, cached1 = -1;
+	for (int y = 0; y < height; ++y) {
+		float fy = (y + 0.5f) * scale_y - 0.5f;
+		int sy = (int) std::floor(fy);
+		fy -= sy;
+		if (sy < 0) {
+			sy = 0;
+			fy = 0;
+		}
+		if (sy >= img.rows - 1) {
+			sy = img.rows - 1;
+			fy = 0;
+		}
+		int sy1 = std::min(sy + 1, img.rows - 1);
+
+		/* Reuse the rows already interpolated for the previous output row */
+		if (sy == cached1 && sy != cached0) {
+			std::swap(row0, row1);
+			std::swap(cached0, cached1);
+		}
+		if (sy != cached0) {
+			InterpolateRow(img.ptr<uchar>(sy), cn, &xofs0[0], &xofs1[0], &xalpha[0], width, row0);
+			cached0 = sy;
+		}
+		if (sy1 != cached1) {
+			InterpolateRow(img.ptr<uchar>(sy1), cn, &xofs0[0], &xofs1[0], &xalpha[0], width, row1);
+			cached1 = sy1;
+		}
+
+		for (int c = 0; c < cn; ++c)
+			BlendRows(row0 + c * width, row1 + c * width, fy, mean[c], width,
+			          output + (c * height + y) * width);
 	}
 }
 
-/* Apply some transformation to the batch of images */
-void Classifier::PreprocessBatch(const vector<cv::Mat> imgs,
-                                      std::vector< std::vector<cv::Mat> >* input_batch){
-    for (unsigned int i = 0 ; i < imgs.size(); i++){
-        cv::Mat img = imgs[i];
-        std::vector<cv::Mat> *input_channels = &(input_batch->at(i));
-
-        /* Convert the input image to the input image format of the network. */
-        cv::Mat sample;
-        if (img.channels() == 3 && num_channels_ == 1)
-          cv::cvtColor(img, sample, CV_BGR2GRAY);
-        else if (img.channels() == 4 && num_channels_ == 1)
-          cv::cvtColor(img, sample, CV_BGRA2GRAY);
-        else if (img.channels() == 4 && num_channels_ == 3)
-          cv::cvtColor(img, sample, CV_BGRA2BGR);
-        else if (img.channels() == 1 && num_channels_ == 3)
-          cv::cvtColor(img, sample, CV_GRAY2BGR);
-        else
-          sample = img;
-
-        cv::Mat sample_resized;
-        if(sample.size() != input_geometry_)
-          cv::resize(sample, sample_resized, input_geometry_);
-        else
-          sample_resized = sample;
-
-        cv::Mat sample_float;
-        if (num_channels_ == 3)
-          sample_resized.convertTo(sample_float, CV_32FC3);
-        else
-          sample_resized.convertTo(sample_float, CV_32FC1);
-
-        cv::Mat sample_normalized;
-        cv::subtract(sample_float, mean_, sample_normalized);
-
-        /* This operation will write the separate BGR planes directly to the
-         * input layer of the network because it is wrapped by the cv::Mat
-         * objects in input_channels. */
-        cv::split(sample_normalized, *input_channels);
-    }
+/* Preprocess the images of a batch in parallel, each one on its own
+ * slot of the input layer. */
+class PreprocessBody : public cv::ParallelLoopBody {
+	public:
+		PreprocessBody(const vector<cv::Mat>& imgs, cv::Size geometry, int num_channels,
+		               const std::vector<float>& mean, float* input_data)
+			: imgs_(imgs), geometry_(geometry), num_channels_(num_channels),
+			  mean_(mean), input_data_(input_data) {}
+
+		virtual void operator()(const cv::Range& range) const {
+			for (int i = range.start; i < range.end; ++i) {
+				cv::Mat img = imgs_[i];
+
+				/* Convert the input image to the input image format of the network. */
+				cv::Mat sample;
+				if (img.channels() == 3 && num_channels_ == 1)
+				  cv::cvtColor(img, sample, CV_BGR2GRAY);
+				else if (img.channels() == 4 && num_channels_ == 1)
+				  cv::cvtColor(img, sample, CV_BGRA2GRAY);
+				else if (img.channels() == 4 && num_channels_ == 3)
+				  cv::cvtColor(img, sample, CV_BGRA2BGR);
+				else if (img.channels() == 1 && num_channels_ == 3)
+				  cv::cvtColor(img, sample, CV_GRAY2BGR);
+				else
+				  sample = img;
+
+				Classifier::PreprocessImage(sample, geometry_, mean_,
+				    input_data_ + (size_t) i * num_channels_ * geometry_.area());
+			}
+		}
+
+	private:
+		const vector<cv::Mat>& 		imgs_;
+		cv::Size 					geometry_;
+		int 						num_channels_;
+		const std::vector<float>& 	mean_;
+		float* 						input_data_;
+};
+
+/* Apply some transformation to the batch of images, writing the result
+ * to input_data (num x channels x height x width) */
+void Classifier::PreprocessBatch(const vector<cv::Mat>& imgs, cv::Size geometry, int num_channels,
+                                 const std::vector<float>& mean, float* input_data) {
+	cv::parallel_for_(cv::Range(0, imgs.size()),
+	                  PreprocessBody(imgs, geometry, num_channels, mean, input_data));
 }
-
-
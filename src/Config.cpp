@@ -0,0 +1,71 @@
+
+#include "../include/Config.hpp"
+#include <algorithm>
+#include <functional>
+
+/* Validator of an option that admits only the given values */
+static std::function<void(const string&)> checkChoice(const string &option, const vector<string> &choices){
+	return [=](const string &value){
+		if(std::find(choices.begin(), choices.end(), value) == choices.end())
+			throw po::validation_error(po::validation_error::invalid_option_value, option, value);
+	};
+}
+
+/* Validator of a numeric option that admits only the values of a range */
+template <typename T>
+static std::function<void(T)> checkRange(const string &option, T min, T max){
+	return [=](T value){
+		if(value < min || value > max)
+			throw po::validation_error(po::validation_error::invalid_option_value, option, std::to_string(value));
+	};
+}
+
+/* Validator of the polygons of the regions of interest */
+static void checkRegions(const vector<string> &specs){
+	for(unsigned int i = 0; i < specs.size(); i++){
+		int stream;
+		vector<Point2f> polygon;
+		if(!RegionOfInterest::parse(specs[i], stream, polygon))
+			throw po::validation_error(po::validation_error::invalid_option_value, "roi", specs[i]);
+	}
+}
+
+/* Declare the options allowed in the configuration file */
+po::options_description configFileOptions(Parameters &params){
+	po::options_description config_file_options("Configuration parameters");
+	config_file_options.add_options()
+	("net_path", po::value<string>(&params.netPath)->required(), "Specify the path of the CNN")
+	("backend", po::value<string>(&params.backend)->default_value("caffe")->notifier(checkChoice("backend", {"caffe", "opencv", "native"})), "Set the inference backend that runs the CNN: caffe, opencv (DNN module) or native (built-in kernels for SqueezeNet)")
+	("bundle", po::value<string>(&params.bundlePath)->default_value(""), "Load the net, its mean values and labels from a bundle written by --compile-model, run by the native backend, instead of net_path")
+	("scaling_factor", po::value<int>(&params.sf)->required(), "Set the scaling factor of the frame, aspect ratio 16:9")
+	("detectionLevel", po::value<int>(&params.detectionLevel)->default_value(0)->notifier(checkRange("detectionLevel", 0, 3)), "Set how many times the frame is halved to detect the moving objects, which are still cut from the whole frame")
+	("subtractor", po::value<string>(&params.subtractor)->default_value("mog2")->notifier(checkChoice("subtractor", {"mog2", "mixture"})), "Set the background subtractor: mog2 (OpenCV) or mixture (same model, vectorized and split in parallel stripes)")
+	("learningRate", po::value<float>(&params.learningRate)->default_value(-1), "Set the learning rate of the background subtractor, negative to derive it from the frames seen")
+	("blurSize", po::value<int>(&params.blurSize)->default_value(BLUR_KERNEL_SIZE)->notifier(checkRange("blurSize", 1, 99)), "Set the dimension of the blur kernel")
+	("dilateSize", po::value<int>(&params.dilateSize)->default_value(DILATE_KERNEL_SIZE)->notifier(checkRange("dilateSize", 1, 99)), "Set the dimension of the dilate kernel")
+	("erodeSize", po::value<int>(&params.erodeSize)->default_value(ERODE_KERNEL_SIZE)->notifier(checkRange("erodeSize", 1, 99)), "Set the dimension of the erode kernel")
+	("maxObjs", po::value<int>(&params.maxObjs)->required(), "Set maximum number of objects per frame")
+	("globalChangeTH", po::value<float>(&params.globalChangeTH)->default_value(0.5)->notifier(checkRange("globalChangeTH", 0.f, 1.f)), "Set the fraction of the frame in the foreground over which the frame is a global change of the scene (lighting flash): nothing is searched in it and the subtractor learns faster for a few frames; 1 to disable")
+	("probTH", po::value<float>(&params.probTH)->required(), "Set probability threshold")
+	("distanceTH", po::value<float>(&params.distanceTH)->required(), "Set distance threshold")
+	("avgColorTH", po::value<float>(&params.avgColorTH)->required(), "Set average color threshold")
+	("noUpdateTH", po::value<int>(&params.noUpdateTH)->required(), "Set no update threshold")
+	("lifetimeTH", po::value<int>(&params.lifetimeTH)->required(), "Set lifetime threshold")
+	("reclassifyBudget", po::value<int>(&params.reclassifyBudget)->default_value(4)->notifier(checkRange("reclassifyBudget", 0, 256)), "Set maximum number of tracks classified per frame, the least confident first; 0 to classify each track once")
+	("assignment", po::value<string>(&params.assignment)->default_value("greedy")->notifier(checkChoice("assignment", {"greedy", "global"})), "Set how objects are assigned to tracks: greedy (nearest object, track by track) or global (minimum total cost)")
+	("motionModel", po::value<string>(&params.motionModel)->default_value("kalman")->notifier(checkChoice("motionModel", {"kalman", "none"})), "Set how the tracks follow their objects: kalman (constant velocity, objects searched around the predicted position) or none (around the last position)")
+	("colorMask", po::value<bool>(&params.colorMask)->default_value(false), "Compute the mean color of an object only on its foreground pixels")
+	("queueSize", po::value<int>(&params.queueSize)->default_value(4), "Set maximum number of frames waiting between two stages of the pipeline")
+	("maxBatchSize", po::value<int>(&params.maxBatchSize)->default_value(16), "Set maximum number of objects classified together")
+	("maxBatchWait", po::value<float>(&params.maxBatchWait)->default_value(0), "Set maximum time (ms) an object waits for its batch to fill")
+	("replicas", po::value<int>(&params.replicas)->default_value(1)->notifier(checkRange("replicas", 1, 64)), "Set the replicas of the network, sharing its weights: a batch is split among the idle ones, and concurrent batches run on different ones")
+	("targetLatency", po::value<int>(&params.targetLatency)->default_value(200)->notifier(checkRange("targetLatency", 1, 10000)), "Set the end-to-end latency (ms) kept on live streams, by skipping classification and then detection on some frames")
+	("metricsPort", po::value<int>(&params.metricsPort)->default_value(0)->notifier(checkRange("metricsPort", 0, 65535)), "Serve the metrics on this port of the loopback interface, over HTTP in the Prometheus format (GET /json for JSON); 0 for none")
+	("metricsSocket", po::value<string>(&params.metricsSocket)->default_value(""), "Serve the metrics over HTTP on this Unix socket, like metricsPort")
+	("metricsSnapshot", po::value<string>(&params.metricsSnapshot)->default_value(""), "Write the metrics as JSON to this file every metricsInterval seconds")
+	("metricsInterval", po::value<int>(&params.metricsInterval)->default_value(10)->notifier(checkRange("metricsInterval", 1, 3600)), "Set the seconds between two snapshots of the metrics")
+	("video_source", po::value< vector<string> >(&params.videoSources)->composing(), "Add a video source to analyze in multi-stream mode, either a video path or a camera index")
+	("roi", po::value< vector<string> >(&params.roi)->composing()->notifier(checkRegions), "Add a polygon where objects are searched, as \"[stream:] x,y x,y x,y ...\" with coordinates between 0 and 1");
+
+	return config_file_options;
+}
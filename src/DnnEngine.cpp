@@ -0,0 +1,76 @@
+#include "../include/DnnEngine.hpp"
+#include <fstream>
+#include <iostream>
+
+/* Read the shape of the input layer (num, channels, height, width) from the prototxt: the first four dimensions
+ * given either as input_dim or as dim of the input shape */
+static std::vector<int> readInputShape(const std::string &model_file){
+	std::ifstream model(model_file.c_str());
+	std::vector<int> shape;
+	std::string token;
+
+	while(shape.size() < 4 && model >> token){
+		if(token.compare("dim:") == 0 || token.compare("input_dim:") == 0){
+			int dim;
+			if(model >> dim)
+				shape.push_back(dim);
+		}
+	}
+	return shape;
+}
+
+/* Load the network once per batch size, and run each net once to warm it up */
+DnnEngine::DnnEngine(const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes)
+	: sizes_(batchSizes), outputSize_(0), model_file_(model_file), trained_file_(trained_file) {
+
+	std::vector<int> shape = readInputShape(model_file);
+	if(shape.size() < 4){
+		std::cerr << "ERROR! Unable to read the input shape of " << model_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	channels_ = shape[1];
+	geometry_ = cv::Size(shape[3], shape[2]);
+
+	for(size_t i = 0; i < sizes_.size(); i++){
+		nets_.push_back(cv::dnn::readNetFromCaffe(model_file, trained_file));
+		if(nets_.back().empty()){
+			std::cerr << "ERROR! Unable to load " << model_file << " and " << trained_file << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		nets_.back().setPreferableBackend(cv::dnn::DNN_BACKEND_DEFAULT);
+		nets_.back().setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+		inputs_.push_back(std::vector<float>((size_t) sizes_[i] * channels_ * geometry_.area(), 0));
+
+		forward(sizes_[i]);
+		outputSize_ = output_.total() / sizes_[i];
+	}
+}
+
+/* Position of the net shaped for the given batch size */
+int DnnEngine::index(int size) const{
+	for(size_t i = 0; i < sizes_.size(); i++)
+		if(sizes_[i] == size)
+			return i;
+	std::cerr << "ERROR! No net shaped for batches of " << size << " images" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+float *DnnEngine::input(int size){
+	return &inputs_[index(size)][0];
+}
+
+std::unique_ptr<InferenceEngine> DnnEngine::replicate() const{
+	return std::unique_ptr<InferenceEngine>(new DnnEngine(model_file_, trained_file_, sizes_));
+}
+
+/* The input buffer is given to the net without copies, as a 4-dimensional blob */
+const float *DnnEngine::forward(int size){
+	int i = index(size);
+	int dims[] = {sizes_[i], channels_, geometry_.height, geometry_.width};
+
+	nets_[i].setInput(cv::Mat(4, dims, CV_32F, &inputs_[i][0]));
+	output_ = nets_[i].forward();
+	if(!output_.isContinuous())
+		output_ = output_.clone();
+	return output_.ptr<float>();
+}
@@ -0,0 +1,29 @@
+#include "../include/FeatureCache.hpp"
+
+using namespace cv;
+
+/* Mean color of the whole rectangle, used when none of its pixels is in the mask */
+static Vec3f plainMean(const Mat &image, Rect rec){
+	Scalar color = mean(Mat(image, rec));
+	return Vec3f(color[0], color[1], color[2]);
+}
+
+/* Start the statistics of a new frame. The mask selects the pixels considered, typically the foreground */
+void FeatureCache::reset(Mat image, Mat mask){
+	image_ = image;
+	mask_ = mask;
+}
+
+/* Mean color of several rectangles, each one averaged over its own pixels */
+void FeatureCache::meanColors(const std::vector<Rect> &recs, std::vector<Vec3f> &colors){
+	colors.resize(recs.size());
+	for(unsigned int i = 0; i < recs.size(); i++){
+		if(mask_.empty() || countNonZero(Mat(mask_, recs[i])) == 0){
+			colors[i] = plainMean(image_, recs[i]);
+		}
+		else{
+			Scalar color = mean(Mat(image_, recs[i]), Mat(mask_, recs[i]));
+			colors[i] = Vec3f(color[0], color[1], color[2]);
+		}
+	}
+}
@@ -0,0 +1,181 @@
+#include "../include/ForegroundFilter.hpp"
+#include "../include/TargetClones.hpp"
+#include <string.h>
+
+using namespace cv;
+
+/* Operations of the dilation and of the erosion. Pixels out of the mask are padding, which never changes the result */
+struct MaxOp {
+	enum { padding = 0 };
+	static KERNEL_INLINE uint8_t apply(uint8_t a, uint8_t b){ return a > b ? a : b; }
+};
+
+struct MinOp {
+	enum { padding = 255 };
+	static KERNEL_INLINE uint8_t apply(uint8_t a, uint8_t b){ return a < b ? a : b; }
+};
+
+/* Element-wise operation of two rows, vectorized by the compiler */
+template <typename Op>
+static KERNEL_INLINE void combineRows(const uint8_t *a, const uint8_t *b, uint8_t *dst, int width){
+	for(int x = 0; x < width; x++)
+		dst[x] = Op::apply(a[x], b[x]);
+}
+
+/* Operation on the window of size pixels centered on each pixel of a row. Windows of 1, 2, 4, ... pixels are combined
+ * in turn, so that every step is an element-wise operation of two rows. line and swap hold width + size pixels */
+template <typename Op>
+static KERNEL_INLINE void filterRow(const uint8_t *src, uint8_t *dst, int width, int size, uint8_t *line, uint8_t *swap){
+	int radius = size / 2;
+	int length = width + 2 * radius;
+	int span = 1;
+
+	memset(line, Op::padding, radius);
+	memcpy(line + radius, src, width);
+	memset(line + radius + width, Op::padding, radius);
+	for(; span * 2 <= size; span *= 2){
+		length -= span;
+		combineRows<Op>(line, line + span, swap, length);
+		std::swap(line, swap);
+	}
+	combineRows<Op>(line, line + size - span, dst, width);
+}
+
+/* Operation on the windows of size consecutive rows, given one at a time (van Herk/Gil-Werman).
+ * The rows are split into blocks of size rows: every window spans the end of a block and the beginning of the next one,
+ * so it is the operation of the running suffix of the first (computed once the block is complete) and of the running
+ * prefix of the second. Each row costs three element-wise operations, whatever the size of the window.
+ * A row must not change until its block is complete, i.e. for size rows after it was given */
+template <typename Op>
+class RunningFilter {
+
+	private:
+		int 		size_;		//Rows of a window
+		int 		width_;		//Pixels of a row
+		int 		phase_;		//Position of the next row in its block
+		int 		pushed_;	//Rows given so far
+		uint8_t * 	prefix_;	//Operation of the rows of the current block given so far
+		uint8_t * 	suffix_;	//Operation of each row of the last complete block and of the following ones of the block
+		std::vector<const uint8_t *> block_;	//Rows of the current block
+
+	public:
+		/* memory holds size + 1 rows */
+		RunningFilter(int size, int width, uint8_t *memory)
+			: size_(size), width_(width), phase_(0), pushed_(0), prefix_(memory), suffix_(memory + width), block_(size) {}
+
+		/* Give the next row. Once size rows have been given, every row completes a window, whose result is written to out */
+		KERNEL_INLINE bool push(const uint8_t *row, uint8_t *out){
+			block_[phase_] = row;
+			if(phase_ == 0)
+				memcpy(prefix_, row, width_);
+			else
+				combineRows<Op>(prefix_, row, prefix_, width_);
+
+			//The window ends in the current block and starts in the previous one, after the row in the same position
+			int start = phase_ + 1;
+			if(start == size_){
+				//Block complete: the window is the block itself, and the suffixes of the block are computed for the next windows
+				memcpy(suffix_ + phase_ * width_, row, width_);
+				for(int i = phase_ - 1; i >= 0; i--)
+					combineRows<Op>(suffix_ + (i + 1) * width_, block_[i], suffix_ + i * width_, width_);
+				start = 0;
+			}
+			phase_ = start;
+
+			if(++pushed_ < size_)
+				return false;
+			combineRows<Op>(suffix_ + start * width_, prefix_, out, width_);
+			return true;
+		}
+};
+
+ForegroundFilter::ForegroundFilter(int blurSize, int dilateSize, int erodeSize)
+	: blurSize_(blurSize | 1), dilateSize_(dilateSize | 1), erodeSize_(erodeSize | 1) {
+
+	/* Box filters with the variance of the gaussian kernel: the variance of a box of side w is (w^2 - 1) / 12,
+	 * the passes use the two odd sides around the ideal one (Kovesi) */
+	if(blurSize_ > GAUSSIAN_MAX_SIZE){
+		double sigma = 0.3 * ((blurSize_ - 1) * 0.5 - 1) + 0.8;	//Same sigma as GaussianBlur
+		double variance = 12 * sigma * sigma;
+		int lower = (int)sqrt(variance / BOX_FILTER_PASSES + 1);
+		if(lower % 2 == 0)
+			lower--;
+		int smaller = cvRound((variance - BOX_FILTER_PASSES * lower * lower - 4 * BOX_FILTER_PASSES * lower - 3 * BOX_FILTER_PASSES) / (-4. * lower - 4));
+		for(int i = 0; i < BOX_FILTER_PASSES; i++)
+			boxSizes_.push_back(i < smaller ? lower : lower + 2);
+	}
+}
+
+/* Gaussian blur of the frame, approximated by box filters when the kernel is larger than GAUSSIAN_MAX_SIZE */
+void ForegroundFilter::blur(const Mat &frame, Mat &blurred) const{
+	if(boxSizes_.empty()){
+		GaussianBlur(frame, blurred, Size(blurSize_, blurSize_), 0);
+		return;
+	}
+
+	cv::blur(frame, blurred, Size(boxSizes_[0], boxSizes_[0]));
+	for(unsigned int i = 1; i < boxSizes_.size(); i++)
+		cv::blur(blurred, blurred, Size(boxSizes_[i], boxSizes_[i]));
+}
+
+/* Closing of the mask: dilation, then erosion, as dilate and erode with rectangular kernels and default borders.
+ * The four separable passes run one row at a time: each row of the mask is dilated horizontally, completes the vertical
+ * dilation of an earlier row, which is eroded horizontally and completes the vertical erosion of a row of the result.
+ * Only the last rows of each pass are kept in memory, so the mask is read once and the intermediate rows stay in cache.
+ * memory holds 2 * (dilateSize + erodeSize + 2) rows and two lines of width + max(dilateSize, erodeSize) pixels */
+static KERNEL_TARGETS void closeRows(const Mat &mask, Mat &closed, int dilateSize, int erodeSize, uint8_t *memory){
+	int width = mask.cols;
+	int height = mask.rows;
+	int dilateRadius = dilateSize / 2;
+	int erodeRadius = erodeSize / 2;
+	int lineWidth = width + std::max(dilateSize, erodeSize);
+
+	//Padding rows, last rows of each horizontal pass, lines of the horizontal passes, state of each vertical pass
+	uint8_t *background = memory;
+	uint8_t *foreground = background + width;
+	uint8_t *dilatedRows = foreground + width;
+	uint8_t *erodedRows = dilatedRows + dilateSize * width;
+	uint8_t *line = erodedRows + erodeSize * width;
+	uint8_t *swap = line + lineWidth;
+	RunningFilter<MaxOp> dilation(dilateSize, width, swap + lineWidth);
+	RunningFilter<MinOp> erosion(erodeSize, width, swap + lineWidth + (dilateSize + 1) * width);
+	memset(background, MaxOp::padding, width);
+	memset(foreground, MinOp::padding, width);
+	int written = 0;
+
+	//Rows above the mask
+	for(int y = 0; y < erodeRadius; y++)
+		erosion.push(foreground, NULL);
+
+	for(int y = -dilateRadius; y < height + dilateRadius; y++){
+		const uint8_t *row = background;
+		if(y >= 0 && y < height){
+			//Each row is kept until the vertical dilation is done with it
+			uint8_t *dilatedRow = dilatedRows + (y % dilateSize) * width;
+			filterRow<MaxOp>(mask.ptr<uint8_t>(y), dilatedRow, width, dilateSize, line, swap);
+			row = dilatedRow;
+		}
+
+		//Each dilated row is kept until the vertical erosion is done with it
+		uint8_t *erodedRow = erodedRows + (y + dilateRadius) % erodeSize * width;
+		if(dilation.push(row, erodedRow)){
+			filterRow<MinOp>(erodedRow, erodedRow, width, erodeSize, line, swap);
+			if(erosion.push(erodedRow, closed.ptr<uint8_t>(written)))
+				written++;
+		}
+	}
+
+	//Rows below the mask
+	for(int y = 0; y < erodeRadius; y++)
+		if(erosion.push(foreground, closed.ptr<uint8_t>(written)))
+			written++;
+}
+
+/* Closing of the mask with the dilation and erosion kernels of the filter. The mask can be closed in place */
+void ForegroundFilter::close(const Mat &mask, Mat &closed){
+	CV_Assert(mask.type() == CV_8U);
+
+	buffer_.resize(2 * (dilateSize_ + erodeSize_ + 2) * mask.cols + 2 * (mask.cols + std::max(dilateSize_, erodeSize_)));
+	closed.create(mask.size(), CV_8U);
+	closeRows(mask, closed, dilateSize_, erodeSize_, buffer_.data());
+}
@@ -0,0 +1,32 @@
+#include "../include/FramePool.hpp"
+
+using namespace cv;
+
+FramePool::FramePool(int buffers) : next_(0), reserve_(buffers) {}
+
+/* A buffer is free when the reference of the pool is the only one left. The count can only drop meanwhile:
+ * whoever could add a reference to the buffer holds one already */
+bool FramePool::available(const Mat &buffer, Size size, int type) const {
+	return buffer.size() == size && buffer.type() == type && CV_XADD(&buffer.u->refcount, 0) == 1;
+}
+
+/* Look for a free buffer starting after the last one handed out, so that the buffers are reused in turn.
+ * The first request of a geometry allocates reserve_ buffers at once, later ones a single buffer if none is free */
+Mat FramePool::acquire(Size size, int type){
+	for(size_t i = 0; i < buffers_.size(); i++){
+		size_t index = (next_ + i) % buffers_.size();
+		if(available(buffers_[index], size, type)){
+			next_ = index + 1;
+			return buffers_[index];
+		}
+	}
+
+	bool known = false;
+	for(size_t i = 0; i < buffers_.size() && !known; i++)
+		known = buffers_[i].size() == size && buffers_[i].type() == type;
+	size_t first = buffers_.size();
+	for(int i = 0; i < (known ? 1 : std::max(reserve_, 1)); i++)
+		buffers_.push_back(Mat(size, type));
+	next_ = first + 1;
+	return buffers_[first];
+}
@@ -0,0 +1,117 @@
+#include "../include/FrameReplay.hpp"
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignOffset(uint64_t offset){
+	return (offset + REPLAY_ALIGN - 1) / REPLAY_ALIGN * REPLAY_ALIGN;
+}
+
+static void invalid(const std::string &replay_file, const std::string &reason){
+	std::cerr << "ERROR! Invalid frame replay " << replay_file << ": " << reason << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+/* Map the replay and check that all its frames lie inside it */
+FrameReplay::FrameReplay(const std::string &replay_file)
+	: data_(MAP_FAILED), size_(0), next_(0) {
+
+	int fd = open(replay_file.c_str(), O_RDONLY);
+	struct stat info;
+	if(fd < 0 || fstat(fd, &info) != 0){
+		std::cerr << "ERROR! Unable to open frame replay " << replay_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	size_ = info.st_size;
+	if(size_ >= sizeof(ReplayHeader))
+		data_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(data_ == MAP_FAILED)
+		invalid(replay_file, "too short or not readable");
+
+	memcpy(&header_, data_, sizeof(header_));
+	if(memcmp(header_.magic, REPLAY_MAGIC, sizeof(header_.magic)) != 0)
+		invalid(replay_file, "not a replay");
+	if(header_.version != REPLAY_VERSION)
+		invalid(replay_file, "recorded by another version, run --record-frames again");
+	if(header_.size != size_)
+		invalid(replay_file, "truncated");
+	if(header_.width < 1 || header_.height < 1 || header_.rowStride < (uint64_t) header_.width * 3
+			|| header_.frameStride < header_.rowStride * header_.height || header_.frameOffset % REPLAY_ALIGN != 0
+			|| header_.frameStride % REPLAY_ALIGN != 0 || header_.frameOffset + header_.frames * header_.frameStride > size_)
+		invalid(replay_file, "frames out of the file");
+
+	//Frames are read in order, the kernel can read ahead and drop the pages behind
+	madvise(data_, size_, MADV_SEQUENTIAL);
+}
+
+FrameReplay::~FrameReplay(){
+	munmap(data_, size_);
+}
+
+bool FrameReplay::next(cv::Mat &frame){
+	if(next_ >= header_.frames)
+		return false;
+	frame = this->frame(next_++);
+	return true;
+}
+
+/* The view does not own its pixels: the mapping is read only, so OpenCV never writes nor frees them through it */
+cv::Mat FrameReplay::frame(uint64_t index) const {
+	uint8_t *pixels = (uint8_t *) data_ + header_.frameOffset + index * header_.frameStride;
+	return cv::Mat(header_.height, header_.width, CV_8UC3, pixels, header_.rowStride);
+}
+
+bool FrameReplay::isReplay(const std::string &file){
+	char magic[sizeof(((ReplayHeader *) 0)->magic)];
+	std::ifstream in(file.c_str(), std::ios::binary);
+	return in.read(magic, sizeof(magic)) && memcmp(magic, REPLAY_MAGIC, sizeof(magic)) == 0;
+}
+
+/* Decode the video once and write its frames resized to the given size, as the analysis resizes them. The header is
+ * written last, once the number of frames is known, and the file is renamed only when complete */
+void recordReplay(const std::string &video_file, const std::string &replay_file, cv::Size size){
+	cv::VideoCapture input(video_file);
+	if(!input.isOpened()){
+		std::cerr << "ERROR! Unable to open video stream " << video_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	ReplayHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+	header.version = REPLAY_VERSION;
+	header.width = size.width;
+	header.height = size.height;
+	header.fps = input.get(CV_CAP_PROP_FPS);
+	header.rowStride = size.width * 3;
+	header.frameStride = alignOffset(header.rowStride * size.height);
+	header.frameOffset = alignOffset(sizeof(header));
+
+	std::string temporary = replay_file + ".tmp";
+	std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+	std::vector<char> padding(header.frameOffset, 0);
+	out.write(&padding[0], padding.size());
+
+	cv::Mat decoded, frame(size, CV_8UC3);
+	padding.assign(header.frameStride - header.rowStride * size.height, 0);
+	while(out && input.read(decoded)){
+		cv::resize(decoded, frame, size, 0, 0, cv::INTER_LINEAR);
+		out.write((const char *) frame.data, header.rowStride * size.height);
+		if(!padding.empty())
+			out.write(&padding[0], padding.size());
+		header.frames++;
+	}
+	header.size = header.frameOffset + header.frames * header.frameStride;
+	out.seekp(0);
+	out.write((const char *) &header, sizeof(header));
+	out.close();
+	if(!out || rename(temporary.c_str(), replay_file.c_str()) != 0){
+		std::cerr << "ERROR! Unable to write frame replay " << replay_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,148 @@
+#include "../include/FrameScheduler.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+/* Start capturing the stream. A paced video is read at its own frame rate, a camera as fast as it delivers the frames */
+FrameGrabber::FrameGrabber(VideoCapture &input, bool paced)
+	: input_(input), interval_(0), fresh_(false), over_(false), stopped_(false), dropped_(0) {
+
+	if(paced){
+		double fps = input_.get(CV_CAP_PROP_FPS);
+		interval_ = 1000. / (fps > 0 ? fps : PACED_DEFAULT_FPS);
+	}
+	thread_ = std::thread(&FrameGrabber::run, this);
+}
+
+FrameGrabber::~FrameGrabber(){
+	stop();
+}
+
+/* Capture loop: each frame read replaces the previous one, even if it was never taken */
+void FrameGrabber::run(){
+	Clock::time_point deadline = Clock::now();
+	Mat frame;
+
+	while(true){
+		if(interval_ > 0){
+			std::this_thread::sleep_until(deadline);
+			deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(interval_));
+		}
+
+		bool read = input_.read(frame);
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(stopped_)
+			return;
+		if(!read){
+			//A camera is not supposed to end
+			if(interval_ == 0)
+				cerr << "Unable to read next frame." << endl;
+			over_ = true;
+			available_.notify_all();
+			return;
+		}
+		if(fresh_){
+			dropped_++;
+			metrics.count(FRAMES_DROPPED);
+		}
+		std::swap(latest_, frame);
+		captured_ = Clock::now();
+		fresh_ = true;
+		available_.notify_all();
+	}
+}
+
+/* Take the latest frame into the given buffer, waiting for a frame not taken yet. Return false when the stream is over or the capture stopped */
+bool FrameGrabber::next(FrameContext &ctx, Mat &frame){
+	std::unique_lock<std::mutex> lock(mutex_);
+	available_.wait(lock, [this]{ return fresh_ || over_ || stopped_; });
+	if(!fresh_ || stopped_)
+		return false;
+
+	//The frame is copied, the capture thread keeps writing into its own buffer
+	latest_.copyTo(frame);
+	ctx.captured = captured_;
+	fresh_ = false;
+	return true;
+}
+
+/* Stop the capture thread, once it is done with the frame it is reading. The stream can be released afterwards */
+void FrameGrabber::stop(){
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopped_ = true;
+		available_.notify_all();
+	}
+	if(thread_.joinable())
+		thread_.join();
+}
+
+long FrameGrabber::dropped(){
+	std::lock_guard<std::mutex> lock(mutex_);
+	return dropped_;
+}
+
+FrameScheduler::FrameScheduler(float targetLatency)
+	: targetLatency_(targetLatency), level_(0), latency_(0), settled_(0), calm_(0), planned_(0), shown_(0),
+	  latencySum_(0), latencyMax_(0) {
+	work_[FULL_ANALYSIS] = work_[NO_CLASSIFICATION] = work_[NO_DETECTION] = 0;
+}
+
+/* Work to do on the next frame read, given the current load level. Above level 1, detection runs on one frame
+ * of 2^(level - 1), the other frames only show the tracks */
+FrameWork FrameScheduler::plan(){
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if(level_ == 0)
+		return FULL_ANALYSIS;
+	long stride = 1L << std::max(0, level_ - 1);
+	return planned_++ % stride == 0 ? NO_CLASSIFICATION : NO_DETECTION;
+}
+
+/* Record the latency of a frame just shown and adapt the load level to it */
+void FrameScheduler::done(const FrameContext &ctx){
+	double latency = std::chrono::duration<double, std::milli>(Clock::now() - ctx.captured).count();
+	metrics.count((MetricCounter) (FRAMES_FULL_ANALYSIS + ctx.work));
+	metrics.observeStage("end_to_end", latency);
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	shown_++;
+	work_[ctx.work]++;
+	latencySum_ += latency;
+	latencyMax_ = std::max(latencyMax_, latency);
+	if(targetLatency_ <= 0)
+		return;
+
+	//Exponential moving average, it follows a change of the load within a few frames
+	latency_ = shown_ == 1 ? latency : 0.75 * latency_ + 0.25 * latency;
+	settled_++;
+
+	if(latency_ > targetLatency_){
+		calm_ = 0;
+		if(level_ < SCHEDULER_MAX_LEVEL && settled_ >= SCHEDULER_SETTLE_FRAMES){
+			level_++;
+			settled_ = 0;
+			planned_ = 0;
+		}
+	}
+	else if(latency_ < targetLatency_ / 2){
+		if(++calm_ >= SCHEDULER_RECOVERY_FRAMES && level_ > 0){
+			level_--;
+			calm_ = 0;
+			settled_ = 0;
+			planned_ = 0;
+		}
+	}
+	else
+		calm_ = 0;
+}
+
+/* Report the frames analyzed fully, the ones degraded by the scheduler, the ones dropped by the capture and the latency */
+void FrameScheduler::printStatistics(ostream &out, long dropped){
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	out << "Frames shown: " << shown_ << ", full analysis: " << work_[FULL_ANALYSIS]
+		<< ", without classification: " << work_[NO_CLASSIFICATION] << ", without detection: " << work_[NO_DETECTION]
+		<< ", dropped: " << dropped << endl;
+	out << "  latency mean: " << (shown_ > 0 ? latencySum_ / shown_ : 0) << " ms, max: " << latencyMax_
+		<< " ms, target: " << targetLatency_ << " ms" << endl;
+}
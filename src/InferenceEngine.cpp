@@ -0,0 +1,131 @@
+#include "../include/InferenceEngine.hpp"
+#include "../include/CaffeEngine.hpp"
+#include "../include/DnnEngine.hpp"
+#include "../include/NativeEngine.hpp"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string.h>
+
+/* Create the engine of the given backend: caffe, opencv or native */
+std::unique_ptr<InferenceEngine> createInferenceEngine(const std::string &backend, const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes, bool use_GPU){
+	if(backend.compare("opencv") == 0)
+		return std::unique_ptr<InferenceEngine>(new DnnEngine(model_file, trained_file, batchSizes));
+	if(backend.compare("native") == 0)
+		return std::unique_ptr<InferenceEngine>(new NativeEngine(model_file, trained_file, batchSizes));
+	return std::unique_ptr<InferenceEngine>(new CaffeEngine(model_file, trained_file, batchSizes, use_GPU));
+}
+
+/* Read a varint of the protobuf wire format, return false past the end of the message */
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value){
+	value = 0;
+	for(int shift = 0; data < end && shift < 64; shift += 7){
+		uint8_t byte = *data++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if(!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+/* Read the mean file (a BlobProto in binaryproto format) and return the mean value of each channel, which is subtracted
+ * from every pixel of the input. The message is decoded directly, so that no backend has to be linked to read it:
+ * channels (field 2) or the second dimension of the shape (field 7), and the planar float data (field 5) */
+std::vector<float> readMeanValues(const std::string &mean_file){
+	std::ifstream file(mean_file.c_str(), std::ios::binary);
+	if(!file){
+		std::cerr << "ERROR! Unable to open mean file " << mean_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::vector<uint8_t> message((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const uint8_t *data = message.data(), *end = data + message.size();
+	std::vector<float> values;
+	std::vector<uint64_t> shape;
+	uint64_t channels = 0, key, value;
+
+	while(data < end && readVarint(data, end, key)){
+		int field = key >> 3, type = key & 7;
+		if(type == 0){
+			if(!readVarint(data, end, value))
+				break;
+			if(field == 2)
+				channels = value;
+		}
+		else if(type == 1){
+			data += 8;
+		}
+		else if(type == 5){
+			if(field == 5 && data + 4 <= end){
+				float single;
+				memcpy(&single, data, 4);
+				values.push_back(single);
+			}
+			data += 4;
+		}
+		else if(type == 2){
+			if(!readVarint(data, end, value) || value > (uint64_t)(end - data))
+				break;
+			const uint8_t *next = data + value;
+			if(field == 5){
+				//Packed floats
+				size_t count = value / 4;
+				size_t first = values.size();
+				values.resize(first + count);
+				memcpy(&values[first], data, count * 4);
+			}
+			else if(field == 7){
+				//Shape: packed or repeated dimensions (field 1)
+				while(data < next && readVarint(data, next, key)){
+					if(key == ((1 << 3) | 2)){
+						const uint8_t *dimsEnd;
+						if(!readVarint(data, next, value))
+							break;
+						dimsEnd = data + value;
+						while(data < dimsEnd && readVarint(data, dimsEnd, value))
+							shape.push_back(value);
+					}
+					else if(key == ((1 << 3) | 0) && readVarint(data, next, value))
+						shape.push_back(value);
+					else
+						break;
+				}
+			}
+			data = next;
+		}
+		else
+			break;
+	}
+
+	if(shape.size() == 4)
+		channels = shape[1];
+	if(channels == 0 || values.empty() || values.size() % channels != 0){
+		std::cerr << "ERROR! Unable to read mean file " << mean_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	//The format of the mean file is planar 32-bit float BGR or grayscale
+	std::vector<float> mean;
+	size_t plane = values.size() / channels;
+	for(uint64_t c = 0; c < channels; c++){
+		double sum = 0;
+		for(size_t i = 0; i < plane; i++)
+			sum += values[c * plane + i];
+		mean.push_back(sum / plane);
+	}
+	return mean;
+}
+
+/* Read the labels of the output of the net, one per line */
+std::vector<std::string> readLabels(const std::string &label_file){
+	std::ifstream file(label_file.c_str());
+	std::vector<std::string> labels;
+	std::string line;
+
+	if(!file){
+		std::cerr << "ERROR! Unable to open labels file " << label_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	while(std::getline(file, line))
+		labels.push_back(line);
+	return labels;
+}
@@ -0,0 +1,400 @@
+#include "../include/Metrics.hpp"
+#include <chrono>
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Metrics metrics;
+
+/* Series of the counters: name, labels, type and help */
+static const char *COUNTER_SERIES[METRIC_COUNTERS][4] = {
+	{"tm_frames_total", "work=\"full\"", "counter", "Frames shown, by the work the scheduler planned on them"},
+	{"tm_frames_total", "work=\"no_classification\"", "counter", ""},
+	{"tm_frames_total", "work=\"no_detection\"", "counter", ""},
+	{"tm_frames_dropped_total", "", "counter", "Frames of live streams replaced by a newer one before being analyzed"},
+	{"tm_frames_over_max_objects_total", "", "counter", "Frames whose objects were not classified because there were more than maxObjs"},
+	{"tm_frames_global_change_total", "", "counter", "Frames skipped after the subtraction because more than globalChangeTH of them was foreground"},
+	{"tm_tracks", "", "gauge", "Tracks alive in all the streams"}
+};
+
+/* Upper bounds of the buckets of the histograms, increasing: a 0 after the first bound ends a list shorter than METRICS_MAX_BUCKETS */
+static const double OBJECT_BOUNDS[METRICS_MAX_BUCKETS] = {0, 1, 2, 4, 8, 16, 32, 64};
+static const double BATCH_BOUNDS[METRICS_MAX_BUCKETS] = {1, 2, 4, 8, 16, 32, 64, 128};
+static const double LATENCY_BOUNDS[METRICS_MAX_BUCKETS] = {0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+/* Series of the histograms: name, help, bounds and the scale of the exported values */
+struct HistogramSeries {
+	const char *	name;
+	const char *	help;
+	const double *	bounds;
+	double 			scale;
+};
+
+static const HistogramSeries HISTOGRAM_SERIES[METRIC_HISTOGRAMS] = {
+	{"tm_objects_per_frame", "Objects found in each frame where detection ran, the first bucket counts the frames without objects", OBJECT_BOUNDS, 1},
+	{"tm_batch_size", "Images in each batch run by the network, the sum counts the images classified", BATCH_BOUNDS, 1}
+};
+
+static const HistogramSeries STAGE_SERIES = {"tm_stage_duration_seconds", "Time spent in each stage of the analysis", LATENCY_BOUNDS, 0.001};
+
+static int bucketCount(const double *bounds){
+	int count = 0;
+	while(count < METRICS_MAX_BUCKETS && (count == 0 || bounds[count] > 0))
+		count++;
+	return count;
+}
+
+static void record(HistogramShard &histogram, const double *bounds, double value){
+	int bucket = 0, count = bucketCount(bounds);
+	while(bucket < count && value > bounds[bucket])
+		bucket++;
+	std::atomic<uint64_t> &samples = histogram.buckets[bucket];
+	samples.store(samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	histogram.sum.store(histogram.sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+MetricShard::MetricShard(){
+	for(int i = 0; i < METRIC_COUNTERS; i++)
+		counters[i].store(0);
+	for(int i = 0; i < METRIC_HISTOGRAMS + METRICS_MAX_STAGES; i++){
+		HistogramShard &histogram = i < METRIC_HISTOGRAMS ? histograms[i] : stages[i - METRIC_HISTOGRAMS];
+		for(int j = 0; j <= METRICS_MAX_BUCKETS; j++)
+			histogram.buckets[j].store(0);
+		histogram.sum.store(0);
+	}
+}
+
+/* Shard of the calling thread, created on its first record */
+MetricShard &Metrics::shard(){
+	static thread_local MetricShard *local = NULL;
+	if(!local){
+		local = new MetricShard();
+		std::lock_guard<std::mutex> lock(shardMutex_);
+		shards_.push_back(local);
+	}
+	return *local;
+}
+
+/* Index of the stage, looked up by the address of its name among the stages the thread already recorded,
+ * and by the name among all the stages only the first time */
+int Metrics::stageIndex(MetricShard &shard, const char *stage){
+	for(size_t i = 0; i < shard.stageIndex.size(); i++)
+		if(shard.stageIndex[i].first == stage)
+			return shard.stageIndex[i].second;
+
+	std::lock_guard<std::mutex> lock(shardMutex_);
+	int index = 0;
+	while(index < (int) stages_.size() && stages_[index].compare(stage) != 0)
+		index++;
+	if(index == (int) stages_.size()){
+		if(index == METRICS_MAX_STAGES)
+			index = -1;
+		else
+			stages_.push_back(stage);
+	}
+	shard.stageIndex.push_back(std::make_pair(stage, index));
+	return index;
+}
+
+void Metrics::observe(MetricHistogram histogram, double value){
+	if(!enabled_)
+		return;
+	record(shard().histograms[histogram], HISTOGRAM_SERIES[histogram].bounds, value);
+}
+
+void Metrics::observeStage(const char *stage, double ms){
+	if(!enabled_)
+		return;
+	MetricShard &local = shard();
+	int index = stageIndex(local, stage);
+	if(index >= 0)
+		record(local.stages[index], LATENCY_BOUNDS, ms);
+}
+
+/* Sum the shards of all the threads: the counters, then the buckets and the sum of each histogram */
+void Metrics::merge(std::vector<int64_t> &counters, std::vector< std::vector<double> > &histograms, std::vector<std::string> &stages){
+	std::lock_guard<std::mutex> lock(shardMutex_);
+	stages = stages_;
+	counters.assign(METRIC_COUNTERS, 0);
+	histograms.assign(METRIC_HISTOGRAMS + stages_.size(), std::vector<double>(METRICS_MAX_BUCKETS + 2, 0));
+
+	for(size_t s = 0; s < shards_.size(); s++){
+		for(int i = 0; i < METRIC_COUNTERS; i++)
+			counters[i] += shards_[s]->counters[i].load(std::memory_order_relaxed);
+		for(size_t i = 0; i < histograms.size(); i++){
+			const HistogramShard &histogram = i < METRIC_HISTOGRAMS ? shards_[s]->histograms[i] : shards_[s]->stages[i - METRIC_HISTOGRAMS];
+			for(int j = 0; j <= METRICS_MAX_BUCKETS; j++)
+				histograms[i][j] += histogram.buckets[j].load(std::memory_order_relaxed);
+			histograms[i][METRICS_MAX_BUCKETS + 1] += histogram.sum.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+static std::string labelList(const std::string &labels, const std::string &extra){
+	if(labels.empty() && extra.empty())
+		return "";
+	return "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+}
+
+/* Cumulative buckets, sum and count of a histogram */
+static void writeHistogram(std::ostream &out, const HistogramSeries &series, const std::string &labels, const std::vector<double> &values){
+	int count = bucketCount(series.bounds);
+	double cumulative = 0;
+	for(int j = 0; j < count; j++){
+		std::ostringstream bound;
+		bound << series.bounds[j] * series.scale;
+		cumulative += values[j];
+		out << series.name << "_bucket" << labelList(labels, "le=\"" + bound.str() + "\"") << " " << (uint64_t) cumulative << "\n";
+	}
+	for(int j = count; j <= METRICS_MAX_BUCKETS; j++)
+		cumulative += values[j];
+	out << series.name << "_bucket" << labelList(labels, "le=\"+Inf\"") << " " << (uint64_t) cumulative << "\n";
+	out << series.name << "_sum" << labelList(labels, "") << " " << values[METRICS_MAX_BUCKETS + 1] * series.scale << "\n";
+	out << series.name << "_count" << labelList(labels, "") << " " << (uint64_t) cumulative << "\n";
+}
+
+std::string Metrics::prometheus(){
+	std::vector<int64_t> counters;
+	std::vector< std::vector<double> > histograms;
+	std::vector<std::string> stages;
+	std::ostringstream out;
+	out.precision(10);
+	merge(counters, histograms, stages);
+
+	for(int i = 0; i < METRIC_COUNTERS; i++){
+		if(i == 0 || strcmp(COUNTER_SERIES[i][0], COUNTER_SERIES[i - 1][0]) != 0)
+			out << "# HELP " << COUNTER_SERIES[i][0] << " " << COUNTER_SERIES[i][3] << "\n# TYPE " << COUNTER_SERIES[i][0] << " " << COUNTER_SERIES[i][2] << "\n";
+		out << COUNTER_SERIES[i][0] << labelList(COUNTER_SERIES[i][1], "") << " " << counters[i] << "\n";
+	}
+	for(int i = 0; i < METRIC_HISTOGRAMS; i++){
+		out << "# HELP " << HISTOGRAM_SERIES[i].name << " " << HISTOGRAM_SERIES[i].help << "\n# TYPE " << HISTOGRAM_SERIES[i].name << " histogram\n";
+		writeHistogram(out, HISTOGRAM_SERIES[i], "", histograms[i]);
+	}
+	out << "# HELP " << STAGE_SERIES.name << " " << STAGE_SERIES.help << "\n# TYPE " << STAGE_SERIES.name << " histogram\n";
+	for(size_t i = 0; i < stages.size(); i++)
+		writeHistogram(out, STAGE_SERIES, metricLabel("stage", stages[i]), histograms[METRIC_HISTOGRAMS + i]);
+
+	std::lock_guard<std::mutex> lock(probeMutex_);
+	std::map<std::string, std::vector<MetricProbe *> > families;
+	for(size_t i = 0; i < probes_.size(); i++)
+		families[probes_[i]->family_].push_back(probes_[i]);
+	for(std::map<std::string, std::vector<MetricProbe *> >::iterator it = families.begin(); it != families.end(); ++it){
+		out << "# HELP " << it->first << " " << it->second[0]->help_ << "\n# TYPE " << it->first << " " << (it->second[0]->counter_ ? "counter" : "gauge") << "\n";
+		for(size_t i = 0; i < it->second.size(); i++)
+			out << it->first << labelList(it->second[i]->labels_, "") << " " << it->second[i]->read_() << "\n";
+	}
+	return out.str();
+}
+
+static std::string jsonString(const std::string &text){
+	std::string quoted = "\"";
+	for(size_t i = 0; i < text.size(); i++){
+		if(text[i] == '"' || text[i] == '\\')
+			quoted += '\\';
+		quoted += text[i];
+	}
+	return quoted + "\"";
+}
+
+/* Count, sum and mean of a histogram, with the cumulative buckets as [bound, samples] pairs */
+static void writeJSONHistogram(std::ostream &out, const HistogramSeries &series, const std::vector<double> &values){
+	int count = bucketCount(series.bounds);
+	double cumulative = 0, total = 0;
+	for(int j = 0; j <= METRICS_MAX_BUCKETS; j++)
+		total += values[j];
+	out << "{\"count\": " << (uint64_t) total << ", \"sum\": " << values[METRICS_MAX_BUCKETS + 1] * series.scale
+		<< ", \"mean\": " << (total > 0 ? values[METRICS_MAX_BUCKETS + 1] * series.scale / total : 0) << ", \"buckets\": [";
+	for(int j = 0; j < count; j++){
+		cumulative += values[j];
+		out << (j > 0 ? ", " : "") << "[" << series.bounds[j] * series.scale << ", " << (uint64_t) cumulative << "]";
+	}
+	out << "]}";
+}
+
+std::string Metrics::json(){
+	std::vector<int64_t> counters;
+	std::vector< std::vector<double> > histograms;
+	std::vector<std::string> stages;
+	std::ostringstream out;
+	out.precision(10);
+	merge(counters, histograms, stages);
+
+	out << "{\n  \"time\": " << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	for(int i = 0; i < METRIC_COUNTERS; i++)
+		out << ",\n  " << jsonString(COUNTER_SERIES[i][0] + labelList(COUNTER_SERIES[i][1], "")) << ": " << counters[i];
+	for(int i = 0; i < METRIC_HISTOGRAMS; i++){
+		out << ",\n  " << jsonString(HISTOGRAM_SERIES[i].name) << ": ";
+		writeJSONHistogram(out, HISTOGRAM_SERIES[i], histograms[i]);
+	}
+	for(size_t i = 0; i < stages.size(); i++){
+		out << ",\n  " << jsonString(STAGE_SERIES.name + labelList(metricLabel("stage", stages[i]), "")) << ": ";
+		writeJSONHistogram(out, STAGE_SERIES, histograms[METRIC_HISTOGRAMS + i]);
+	}
+
+	std::lock_guard<std::mutex> lock(probeMutex_);
+	for(size_t i = 0; i < probes_.size(); i++)
+		out << ",\n  " << jsonString(probes_[i]->family_ + labelList(probes_[i]->labels_, "")) << ": " << probes_[i]->read_();
+	out << "\n}\n";
+	return out.str();
+}
+
+MetricProbe::MetricProbe(const std::string &family, const std::string &labels, const std::string &help, bool counter, std::function<double()> read)
+	: family_(family), labels_(labels), help_(help), counter_(counter), read_(read) {
+	std::lock_guard<std::mutex> lock(metrics.probeMutex_);
+	metrics.probes_.push_back(this);
+}
+
+/* Once unregistered the probe is never read again: the probes are read with the lock held */
+MetricProbe::~MetricProbe(){
+	std::lock_guard<std::mutex> lock(metrics.probeMutex_);
+	for(size_t i = 0; i < metrics.probes_.size(); i++)
+		if(metrics.probes_[i] == this){
+			metrics.probes_.erase(metrics.probes_.begin() + i);
+			break;
+		}
+}
+
+std::string metricLabel(const std::string &name, const std::string &value){
+	std::string label = name + "=\"";
+	for(size_t i = 0; i < value.size(); i++){
+		if(value[i] == '\n'){
+			label += "\\n";
+			continue;
+		}
+		if(value[i] == '"' || value[i] == '\\')
+			label += '\\';
+		label += value[i];
+	}
+	return label + "\"";
+}
+
+static void failure(const std::string &what){
+	std::cerr << "ERROR! Unable to export the metrics: " << what << " (" << strerror(errno) << ")" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+/* Open the listening sockets, the TCP one on the loopback interface only */
+MetricsExporter::MetricsExporter(int port, const std::string &socket_path, const std::string &snapshot_file, int interval)
+	: tcp_(-1), unix_(-1), socketPath_(socket_path), snapshotFile_(snapshot_file), interval_(interval > 0 ? interval : 1), stopped_(false) {
+
+	if(port > 0){
+		struct sockaddr_in address;
+		int reuse = 1;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		tcp_ = socket(AF_INET, SOCK_STREAM, 0);
+		if(tcp_ < 0 || setsockopt(tcp_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+				|| bind(tcp_, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(tcp_, 8) != 0)
+			failure("port " + std::to_string(port));
+	}
+	if(!socketPath_.empty()){
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if(socketPath_.size() >= sizeof(address.sun_path))
+			failure("socket path too long " + socketPath_);
+		strcpy(address.sun_path, socketPath_.c_str());
+		unlink(socketPath_.c_str());
+		unix_ = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(unix_ < 0 || bind(unix_, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(unix_, 8) != 0)
+			failure("socket " + socketPath_);
+	}
+	thread_ = std::thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter(){
+	stop();
+}
+
+/* Stop serving, after writing a last snapshot */
+void MetricsExporter::stop(){
+	if(stopped_.exchange(true))
+		return;
+	if(thread_.joinable())
+		thread_.join();
+	if(!snapshotFile_.empty())
+		writeSnapshot();
+	if(tcp_ >= 0)
+		close(tcp_);
+	if(unix_ >= 0){
+		close(unix_);
+		unlink(socketPath_.c_str());
+	}
+}
+
+/* Wait for the requests, waking up at least every 200 ms to check whether to stop or to write the snapshot */
+void MetricsExporter::run(){
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point snapshot = Clock::now() + std::chrono::seconds(interval_);
+
+	while(!stopped_){
+		struct pollfd listeners[2];
+		int count = 0;
+		if(tcp_ >= 0){
+			listeners[count].fd = tcp_;
+			listeners[count++].events = POLLIN;
+		}
+		if(unix_ >= 0){
+			listeners[count].fd = unix_;
+			listeners[count++].events = POLLIN;
+		}
+		if(poll(listeners, count, 200) > 0)
+			for(int i = 0; i < count; i++)
+				if(listeners[i].revents & POLLIN)
+					serve(listeners[i].fd);
+
+		if(!snapshotFile_.empty() && Clock::now() >= snapshot){
+			writeSnapshot();
+			snapshot += std::chrono::seconds(interval_);
+		}
+	}
+}
+
+/* Answer a single request and close the connection: GET /json gets the JSON snapshot, any other path the Prometheus text */
+void MetricsExporter::serve(int listener){
+	int connection = accept(listener, NULL, NULL);
+	if(connection < 0)
+		return;
+
+	struct timeval timeout = {1, 0};
+	setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	std::string request;
+	char buffer[1024];
+	ssize_t received;
+	while(request.find("\r\n\r\n") == std::string::npos && request.size() < 8192 && (received = recv(connection, buffer, sizeof(buffer), 0)) > 0)
+		request.append(buffer, received);
+
+	bool asJSON = request.compare(0, 9, "GET /json") == 0;
+	std::string body = asJSON ? metrics.json() : metrics.prometheus();
+	std::string response = std::string("HTTP/1.0 200 OK\r\nContent-Type: ") + (asJSON ? "application/json" : "text/plain; version=0.0.4")
+		+ "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+	for(size_t sent = 0; sent < response.size(); ){
+		ssize_t written = send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+		if(written <= 0)
+			break;
+		sent += written;
+	}
+	close(connection);
+}
+
+/* Written aside and renamed, so that a reader never sees a partial snapshot */
+void MetricsExporter::writeSnapshot(){
+	std::string temporary = snapshotFile_ + ".tmp";
+	std::ofstream out(temporary.c_str(), std::ios::trunc);
+	out << metrics.json();
+	out.close();
+	if(!out || rename(temporary.c_str(), snapshotFile_.c_str()) != 0)
+		std::cerr << "Unable to write the metrics snapshot " << snapshotFile_ << std::endl;
+}
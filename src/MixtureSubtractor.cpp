@@ -0,0 +1,283 @@
+#include "../include/MixtureSubtractor.hpp"
+#include "../include/TargetClones.hpp"
+#include <string.h>
+
+using namespace cv;
+
+#define MIXTURE_BACKGROUND_RATIO 	0.9f	//Weight of the components describing the background
+#define MIXTURE_VAR_THRESHOLD_GEN 	9.0f	//Squared distance of a pixel from a component it updates
+#define MIXTURE_VAR_INIT 			15.0f	//Variance of a new component
+#define MIXTURE_VAR_MIN 			4.0f	//Minimum variance of a component
+#define MIXTURE_VAR_MAX 			75.0f	//Maximum variance of a component
+#define MIXTURE_COMPLEXITY 			0.05f	//Complexity reduction prior, components below it are dropped
+
+//Vectors of MIXTURE_LANES elements, compiled to either AVX2 or SSE registers
+typedef float 		Lanes 	__attribute__((vector_size(MIXTURE_LANES * sizeof(float))));
+typedef int 		Flags 	__attribute__((vector_size(MIXTURE_LANES * sizeof(int))));
+typedef int 		Ints 	__attribute__((vector_size(MIXTURE_LANES * sizeof(int))));
+typedef uint16_t 	Fixed 	__attribute__((vector_size(MIXTURE_LANES * sizeof(uint16_t))));
+typedef uint8_t 	Counts 	__attribute__((vector_size(MIXTURE_LANES * sizeof(uint8_t))));
+
+/* Rates of the current frame */
+struct MixtureRates {
+	float alpha;			//Learning rate
+	float alpha1;			//1 - learning rate
+	float prune;			//Decrease of the weight of every component
+	float varThreshold;		//Squared distance of a background pixel from its component
+};
+
+//Vectors are passed by reference, their ABI depends on the instruction set
+static KERNEL_INLINE void loadFixed(Lanes &value, const uint16_t *field, float scale){
+	Fixed fixed;
+	memcpy(&fixed, field, sizeof(fixed));
+	value = __builtin_convertvector(fixed, Lanes) * scale;
+}
+
+//No saturation: weights stay between 0 and 1, means between 0 and 255, variances between their limits
+static KERNEL_INLINE void storeFixed(uint16_t *field, const Lanes &value, float scale){
+	Ints rounded = __builtin_convertvector(value * scale + 0.5f, Ints);
+	Fixed fixed = __builtin_convertvector(rounded, Fixed);
+	memcpy(field, &fixed, sizeof(fixed));
+}
+
+static KERNEL_INLINE bool any(const Flags &flags){
+	uint64_t words[sizeof(Flags) / sizeof(uint64_t)];
+	uint64_t result = 0;
+	memcpy(words, &flags, sizeof(flags));
+	for(unsigned int i = 0; i < sizeof(Flags) / sizeof(uint64_t); i++)
+		result |= words[i];
+	return result != 0;
+}
+
+static KERNEL_INLINE void swapLanes(const Flags &swap, Lanes &a, Lanes &b){
+	Lanes aux = swap ? b : a;
+	b = swap ? a : b;
+	a = aux;
+}
+
+/* Move a component up by one position, in the selected lanes */
+static KERNEL_INLINE void swapModes(const Flags &swap, int mode, Lanes weight[], Lanes variance[], Lanes mean[][3]){
+	swapLanes(swap, weight[mode], weight[mode - 1]);
+	swapLanes(swap, variance[mode], variance[mode - 1]);
+	for(int c = 0; c < 3; c++)
+		swapLanes(swap, mean[mode][c], mean[mode - 1][c]);
+}
+
+/* Write back the first components of a block */
+static KERNEL_INLINE void storeBlock(MixtureBlock &block, const Lanes weight[], const Lanes variance[], const Lanes mean[][3], const Lanes &modes, int usedModes){
+	for(int k = 0; k < usedModes; k++){
+		storeFixed(block.weight[k], weight[k], 65535);
+		storeFixed(block.variance[k], variance[k], 256);
+		for(int c = 0; c < 3; c++)
+			storeFixed(block.mean[k][c], mean[k][c], 256);
+	}
+	Counts counts = __builtin_convertvector(__builtin_convertvector(modes, Ints), Counts);
+	memcpy(block.modes, &counts, sizeof(counts));
+}
+
+/* Update the mixtures of a block with its pixels, and tell which pixels are background.
+ * Same steps of MOG2 for every pixel, with branches replaced by per-lane selections */
+static KERNEL_INLINE void updateBlock(MixtureBlock &block, const uchar *pixels, uchar *mask, int lanes, const MixtureRates &rates){
+	Lanes weight[MIXTURE_MODES], variance[MIXTURE_MODES], mean[MIXTURE_MODES][3], data[3];
+	Counts channels[3] = {};
+	const Lanes zero = {};
+
+	//Deinterleave the pixels (BGR)
+	for(int l = 0; l < lanes; l++)
+		for(int c = 0; c < 3; c++)
+			channels[c][l] = pixels[3 * l + c];
+	for(int c = 0; c < 3; c++)
+		data[c] = __builtin_convertvector(__builtin_convertvector(channels[c], Ints), Lanes);
+
+	//Only the components in use in some pixel of the block, and the one that may be created, are touched
+	int maxModes = 0;
+	for(int l = 0; l < MIXTURE_LANES; l++)
+		maxModes = std::max(maxModes, (int)block.modes[l]);
+	int usedModes = std::min(maxModes + 1, MIXTURE_MODES);
+
+	for(int k = 0; k < usedModes; k++){
+		loadFixed(weight[k], block.weight[k], 1.f / 65535);
+		loadFixed(variance[k], block.variance[k], 1.f / 256);
+		for(int c = 0; c < 3; c++)
+			loadFixed(mean[k][c], block.mean[k][c], 1.f / 256);
+	}
+	Counts counts;
+	memcpy(&counts, block.modes, sizeof(counts));
+	Lanes modes = __builtin_convertvector(__builtin_convertvector(counts, Ints), Lanes);
+
+	//Update the weights, find the first component close enough to the pixel and update it
+	Lanes totalWeight = zero, fitMode = zero - 1;
+	Flags fits = {}, background = {};
+	for(int k = 0; k < maxModes; k++){
+		const float mode = k;
+		Flags active = zero + mode < modes;
+		Lanes w = weight[k] * rates.alpha1 + rates.prune;
+
+		Lanes d0 = mean[k][0] - data[0];
+		Lanes d1 = mean[k][1] - data[1];
+		Lanes d2 = mean[k][2] - data[2];
+		Lanes dist2 = d0 * d0 + d1 * d1 + d2 * d2;
+
+		Flags check = active & ~fits;
+		background |= check & (totalWeight < MIXTURE_BACKGROUND_RATIO) & (dist2 < variance[k] * rates.varThreshold);
+		Flags fit = check & (dist2 < variance[k] * MIXTURE_VAR_THRESHOLD_GEN);
+
+		if(any(fit)){
+			w = fit ? w + rates.alpha : w;
+			Lanes rate = rates.alpha / w;
+			mean[k][0] = fit ? mean[k][0] - rate * d0 : mean[k][0];
+			mean[k][1] = fit ? mean[k][1] - rate * d1 : mean[k][1];
+			mean[k][2] = fit ? mean[k][2] - rate * d2 : mean[k][2];
+			Lanes var = variance[k] + rate * (dist2 - variance[k]);
+			var = var < MIXTURE_VAR_MIN ? zero + MIXTURE_VAR_MIN : var;
+			var = var > MIXTURE_VAR_MAX ? zero + MIXTURE_VAR_MAX : var;
+			variance[k] = fit ? var : variance[k];
+			fitMode = fit ? zero + mode : fitMode;
+			fits |= fit;
+		}
+
+		//Drop the components with a negligible weight, the following ones are not visited
+		Flags pruned = active & (w < -rates.prune);
+		w = pruned ? zero : w;
+		modes = pruned ? modes - 1 : modes;
+		weight[k] = active ? w : weight[k];
+		totalWeight += active ? w : zero;
+	}
+
+	//Keep the components sorted by weight
+	for(int k = maxModes - 1; k > 0 && any(fitMode > 0.f); k--){
+		Flags up = (fitMode == (float)k) & (weight[k] >= weight[k - 1]);
+		swapModes(up, k, weight, variance, mean);
+		fitMode = up ? zero + (float)(k - 1) : fitMode;
+	}
+
+	//Normalize the weights
+	Lanes scale = totalWeight > 0.f ? 1.f / totalWeight : zero + 1;
+	for(int k = 0; k < maxModes; k++)
+		weight[k] = zero + (float)k < modes ? weight[k] * scale : weight[k];
+
+	//A pixel far from every component gets a new one, replacing the lightest when there is no room
+	Flags create = ~fits;
+	for(int l = lanes; l < MIXTURE_LANES; l++)
+		create[l] = 0;
+	if(!any(create)){
+		storeBlock(block, weight, variance, mean, modes, maxModes);
+		for(int l = 0; l < lanes; l++)
+			mask[l] = background[l] ? 0 : 255;
+		return;
+	}
+	Flags full = modes == (float)MIXTURE_MODES;
+	Lanes newMode = full ? zero + (float)(MIXTURE_MODES - 1) : modes;
+	modes = create & ~full ? modes + 1 : modes;
+	for(int k = 0; k < usedModes; k++){
+		Flags isNew = create & (newMode == (float)k);
+		Flags older = create & (zero + (float)k < modes - 1);
+		Lanes initial = modes == 1.f ? zero + 1 : zero + rates.alpha;
+		weight[k] = isNew ? initial : (older ? weight[k] * rates.alpha1 : weight[k]);
+		variance[k] = isNew ? zero + MIXTURE_VAR_INIT : variance[k];
+		for(int c = 0; c < 3; c++)
+			mean[k][c] = isNew ? data[c] : mean[k][c];
+	}
+	for(int k = usedModes - 1; k > 0; k--){
+		Flags up = create & (newMode == (float)k) & (weight[k - 1] <= rates.alpha);
+		swapModes(up, k, weight, variance, mean);
+		newMode = up ? zero + (float)(k - 1) : newMode;
+	}
+
+	storeBlock(block, weight, variance, mean, modes, usedModes);
+	for(int l = 0; l < lanes; l++)
+		mask[l] = background[l] ? 0 : 255;
+}
+
+/* Update the mixtures of a row */
+KERNEL_TARGETS
+static void updateRow(MixtureBlock *blocks, const uchar *pixels, uchar *mask, int width, const MixtureRates &rates){
+	int x = 0;
+
+	for(; x + MIXTURE_LANES <= width; x += MIXTURE_LANES, blocks++)
+		updateBlock(*blocks, pixels + 3 * x, mask + x, MIXTURE_LANES, rates);
+	if(x < width)
+		updateBlock(*blocks, pixels + 3 * x, mask + x, width - x, rates);
+}
+
+/* Update of a stripe of rows, run in parallel with the other stripes */
+class MixtureBody : public ParallelLoopBody {
+
+	private:
+		const Mat &			image_;
+		Mat &				mask_;
+		MixtureBlock *		model_;
+		int 				blocksPerRow_;
+		MixtureRates 		rates_;
+
+	public:
+		MixtureBody(const Mat &image, Mat &mask, MixtureBlock *model, int blocksPerRow, const MixtureRates &rates)
+			: image_(image), mask_(mask), model_(model), blocksPerRow_(blocksPerRow), rates_(rates) {}
+
+		void operator()(const Range &rows) const{
+			for(int y = rows.start; y < rows.end; y++)
+				updateRow(model_ + y * blocksPerRow_, image_.ptr<uchar>(y), mask_.ptr<uchar>(y), image_.cols, rates_);
+		}
+};
+
+/* Class constructor */
+MixtureSubtractor::MixtureSubtractor(int history, float varThreshold, double learningRate)
+	: history_(history), varThreshold_(varThreshold), learningRate_(learningRate), blocksPerRow_(0), frames_(0), model_(NULL) {}
+
+/* Compute the foreground mask of the frame and update the model.
+ * A negative learning rate means the one of the constructor, or, if that is negative too, 1 / min(2 * frames, history) */
+void MixtureSubtractor::apply(InputArray _image, OutputArray _fgmask, double learningRate){
+	Mat image = _image.getMat();
+	CV_Assert(image.type() == CV_8UC3);
+
+	//(Re)initialize the model when the frame size changes
+	if(image.size() != size_){
+		size_ = image.size();
+		blocksPerRow_ = (size_.width + MIXTURE_LANES - 1) / MIXTURE_LANES;
+		buffer_.assign(size_.height * blocksPerRow_ * sizeof(MixtureBlock) + 64, 0);
+		model_ = (MixtureBlock *)alignPtr(buffer_.data(), 64);
+		frames_ = 0;
+	}
+
+	frames_++;
+	if(learningRate < 0)
+		learningRate = learningRate_;
+	if(learningRate < 0 || frames_ == 1)
+		learningRate = 1. / std::min(2 * frames_, (long)history_);
+
+	MixtureRates rates;
+	rates.alpha = learningRate;
+	rates.alpha1 = 1 - rates.alpha;
+	rates.prune = -rates.alpha * MIXTURE_COMPLEXITY;
+	rates.varThreshold = varThreshold_;
+
+	_fgmask.create(size_, CV_8U);
+	Mat mask = _fgmask.getMat();
+
+	//Stripes of at least 64K pixels
+	parallel_for_(Range(0, size_.height), MixtureBody(image, mask, model_, blocksPerRow_, rates), image.total() / (double)(1 << 16));
+}
+
+/* Compute the background image: the mean of the heaviest components of each pixel, weighted */
+void MixtureSubtractor::getBackgroundImage(OutputArray backgroundImage) const{
+	Mat background(size_, CV_8UC3, Scalar::all(0));
+
+	for(int y = 0; y < size_.height; y++){
+		for(int x = 0; x < size_.width; x++){
+			const MixtureBlock &block = model_[y * blocksPerRow_ + x / MIXTURE_LANES];
+			int l = x % MIXTURE_LANES;
+			float total = 0, color[3] = {0, 0, 0};
+			for(int k = 0; k < block.modes[l]; k++){
+				float w = block.weight[k][l] / 65535.f;
+				for(int c = 0; c < 3; c++)
+					color[c] += w * block.mean[k][c][l] / 256.f;
+				total += w;
+				if(total > MIXTURE_BACKGROUND_RATIO)
+					break;
+			}
+			if(total > 0)
+				background.at<Vec3b>(y, x) = Vec3b(saturate_cast<uchar>(color[0] / total), saturate_cast<uchar>(color[1] / total), saturate_cast<uchar>(color[2] / total));
+		}
+	}
+	background.copyTo(backgroundImage);
+}
@@ -0,0 +1,210 @@
+#include "../include/ModelBundle.hpp"
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignOffset(uint64_t offset){
+	return (offset + BUNDLE_ALIGN - 1) / BUNDLE_ALIGN * BUNDLE_ALIGN;
+}
+
+static void invalid(const std::string &bundle_file, const std::string &reason){
+	std::cerr << "ERROR! Invalid model bundle " << bundle_file << ": " << reason << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+/* Map the bundle and check that every section lies inside it, and every layer inside the net */
+ModelBundle::ModelBundle(const std::string &bundle_file)
+	: data_(MAP_FAILED), size_(0) {
+
+	int fd = open(bundle_file.c_str(), O_RDONLY);
+	struct stat info;
+	if(fd < 0 || fstat(fd, &info) != 0){
+		std::cerr << "ERROR! Unable to open model bundle " << bundle_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	size_ = info.st_size;
+	if(size_ >= sizeof(BundleHeader))
+		data_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(data_ == MAP_FAILED)
+		invalid(bundle_file, "too short or not readable");
+
+	const uint8_t *bytes = (const uint8_t *) data_;
+	const BundleHeader &header = *(const BundleHeader *) bytes;
+	if(memcmp(header.magic, BUNDLE_MAGIC, sizeof(header.magic)) != 0)
+		invalid(bundle_file, "not a bundle");
+	if(header.version != BUNDLE_VERSION || header.lanes != NATIVE_LANES)
+		invalid(bundle_file, "compiled by another version, run --compile-model again");
+	if(header.size != size_)
+		invalid(bundle_file, "truncated");
+	if(header.meanOffset + header.means * sizeof(float) > size_ || header.bufferOffset + header.buffers * sizeof(BundleBuffer) > size_
+			|| header.blobOffset + header.blobs * sizeof(BundleBlob) > size_ || header.layerOffset + header.layers * sizeof(BundleLayer) > size_
+			|| header.labelOffset + header.labelBytes > size_ || header.parameterOffset + header.parameters * sizeof(float) > size_
+			|| header.parameterOffset % sizeof(float) != 0)
+		invalid(bundle_file, "section out of the file");
+
+	means_.assign((const float *) (bytes + header.meanOffset), (const float *) (bytes + header.meanOffset) + header.means);
+	parameters_ = (const float *) (bytes + header.parameterOffset);
+
+	const char *label = (const char *) (bytes + header.labelOffset), *labelsEnd = label + header.labelBytes;
+	for(uint32_t i = 0; i < header.labels; i++){
+		const char *end = (const char *) memchr(label, 0, labelsEnd - label);
+		if(end == NULL)
+			invalid(bundle_file, "label not terminated");
+		labels_.push_back(std::string(label, end));
+		label = end + 1;
+	}
+
+	const BundleBuffer *buffers = (const BundleBuffer *) (bytes + header.bufferOffset);
+	for(uint32_t i = 0; i < header.buffers; i++){
+		NativeBuffer buffer;
+		buffer.blocks = buffers[i].blocks;
+		buffer.height = buffers[i].height;
+		buffer.width = buffers[i].width;
+		buffer.border = buffers[i].border;
+		if(buffer.blocks < 0 || buffer.height < 1 || buffer.width < 1 || buffer.border < 0)
+			invalid(bundle_file, "empty buffer");
+		net_.buffers.push_back(buffer);
+	}
+
+	const BundleBlob *blobs = (const BundleBlob *) (bytes + header.blobOffset);
+	for(uint32_t i = 0; i < header.blobs; i++){
+		NativeBlob blob;
+		blob.buffer = blobs[i].buffer;
+		blob.firstBlock = blobs[i].firstBlock;
+		blob.channels = blobs[i].channels;
+		if(blob.buffer < 0 || blob.buffer >= (int) header.buffers || blob.channels < 1 || blob.firstBlock < 0
+				|| blob.firstBlock + (blob.channels + NATIVE_LANES - 1) / NATIVE_LANES > net_.buffers[blob.buffer].blocks)
+			invalid(bundle_file, "blob out of its buffer");
+		net_.blobs.push_back(blob);
+	}
+
+	const BundleLayer *layers = (const BundleLayer *) (bytes + header.layerOffset);
+	for(uint32_t i = 0; i < header.layers; i++){
+		NativeLayer layer;
+		layer.type = (NativeLayer::Type) layers[i].type;
+		layer.bottom = layers[i].bottom;
+		layer.top = layers[i].top;
+		layer.kernel = layers[i].kernel;
+		layer.stride = layers[i].stride;
+		layer.pad = layers[i].pad;
+		layer.relu = layers[i].relu != 0;
+		layer.weights = layers[i].weights;
+		layer.bias = layers[i].bias;
+		if(layers[i].type < NativeLayer::CONVOLUTION || layers[i].type > NativeLayer::SOFTMAX || layer.bottom < 0 || layer.bottom >= (int) header.blobs
+				|| layer.top < 0 || layer.top >= (int) header.blobs || layer.kernel < 1 || layer.stride < 1 || layer.pad < 0)
+			invalid(bundle_file, "layer out of the net");
+		if(layer.type == NativeLayer::CONVOLUTION){
+			uint64_t inBlocks = (net_.blobs[layer.bottom].channels + NATIVE_LANES - 1) / NATIVE_LANES;
+			uint64_t outBlocks = (net_.blobs[layer.top].channels + NATIVE_LANES - 1) / NATIVE_LANES;
+			if(layer.weights + outBlocks * inBlocks * layer.kernel * layer.kernel * NATIVE_LANES * NATIVE_LANES > header.parameters
+					|| layer.bias + outBlocks * NATIVE_LANES > header.parameters
+					|| net_.buffers[net_.blobs[layer.bottom].buffer].border < layer.pad)
+				invalid(bundle_file, "convolution out of the parameters");
+		}
+		net_.layers.push_back(layer);
+	}
+
+	net_.input = header.input;
+	net_.output = header.output;
+	if(net_.input < 0 || net_.input >= (int) header.blobs || net_.output < 0 || net_.output >= (int) header.blobs)
+		invalid(bundle_file, "input or output out of the net");
+}
+
+ModelBundle::~ModelBundle(){
+	munmap(data_, size_);
+}
+
+/* Write the sections one after the other, each aligned to BUNDLE_ALIGN bytes */
+void ModelBundle::write(const std::string &bundle_file, const NativeNet &net, const std::vector<float> &parameters,
+		const std::vector<float> &means, const std::vector<std::string> &labels){
+
+	std::vector<BundleBuffer> buffers;
+	for(size_t i = 0; i < net.buffers.size(); i++){
+		BundleBuffer buffer = {net.buffers[i].blocks, net.buffers[i].height, net.buffers[i].width, net.buffers[i].border};
+		buffers.push_back(buffer);
+	}
+	std::vector<BundleBlob> blobs;
+	for(size_t i = 0; i < net.blobs.size(); i++){
+		BundleBlob blob = {net.blobs[i].buffer, net.blobs[i].firstBlock, net.blobs[i].channels};
+		blobs.push_back(blob);
+	}
+	std::vector<BundleLayer> layers;
+	for(size_t i = 0; i < net.layers.size(); i++){
+		const NativeLayer &layer = net.layers[i];
+		BundleLayer record = {layer.type, layer.bottom, layer.top, layer.kernel, layer.stride, layer.pad, layer.relu, 0, layer.weights, layer.bias};
+		layers.push_back(record);
+	}
+	std::string names;
+	for(size_t i = 0; i < labels.size(); i++)
+		names.append(labels[i].c_str(), labels[i].size() + 1);
+
+	BundleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+	header.version = BUNDLE_VERSION;
+	header.lanes = NATIVE_LANES;
+	header.input = net.input;
+	header.output = net.output;
+	header.means = means.size();
+	header.buffers = buffers.size();
+	header.blobs = blobs.size();
+	header.layers = layers.size();
+	header.labels = labels.size();
+	header.labelBytes = names.size();
+	header.parameters = parameters.size();
+	header.meanOffset = alignOffset(sizeof(header));
+	header.bufferOffset = alignOffset(header.meanOffset + means.size() * sizeof(float));
+	header.blobOffset = alignOffset(header.bufferOffset + buffers.size() * sizeof(BundleBuffer));
+	header.layerOffset = alignOffset(header.blobOffset + blobs.size() * sizeof(BundleBlob));
+	header.labelOffset = alignOffset(header.layerOffset + layers.size() * sizeof(BundleLayer));
+	header.parameterOffset = alignOffset(header.labelOffset + names.size());
+	header.size = header.parameterOffset + parameters.size() * sizeof(float);
+
+	std::vector<char> file(header.size, 0);
+	memcpy(&file[0], &header, sizeof(header));
+	if(!means.empty())
+		memcpy(&file[header.meanOffset], means.data(), means.size() * sizeof(float));
+	if(!buffers.empty())
+		memcpy(&file[header.bufferOffset], buffers.data(), buffers.size() * sizeof(BundleBuffer));
+	if(!blobs.empty())
+		memcpy(&file[header.blobOffset], blobs.data(), blobs.size() * sizeof(BundleBlob));
+	if(!layers.empty())
+		memcpy(&file[header.layerOffset], layers.data(), layers.size() * sizeof(BundleLayer));
+	if(!names.empty())
+		memcpy(&file[header.labelOffset], names.data(), names.size());
+	if(!parameters.empty())
+		memcpy(&file[header.parameterOffset], parameters.data(), parameters.size() * sizeof(float));
+
+	//Written aside and renamed, so that a process never maps a bundle being written
+	std::string temporary = bundle_file + ".tmp";
+	std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(&file[0], file.size());
+	out.close();
+	if(!out || rename(temporary.c_str(), bundle_file.c_str()) != 0){
+		std::cerr << "ERROR! Unable to write model bundle " << bundle_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Read the net of the net path (deploy.prototxt, deploy.caffemodel, mean.binaryproto and labels.txt) and write it as a bundle */
+void compileModelBundle(const std::string &net_path, const std::string &bundle_file){
+	std::vector<float> parameters;
+	NativeNet net = readNativeNet(net_path + "/deploy.prototxt", net_path + "/deploy.caffemodel", parameters);
+	std::vector<float> means = readMeanValues(net_path + "/mean.binaryproto");
+	std::vector<std::string> labels = readLabels(net_path + "/labels.txt");
+
+	if((int) means.size() != net.blobs[net.input].channels){
+		std::cerr << "ERROR! Number of channels of mean file doesn't match input layer" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if((int) labels.size() != net.outputSize()){
+		std::cerr << "ERROR! Number of labels is different from the output layer dimension" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	ModelBundle::write(bundle_file, net, parameters, means, labels);
+}
@@ -0,0 +1,122 @@
+
+#include "../include/MultiStream.hpp"
+#include <thread>
+
+/* Analysis of a stream: read the frames, find the moving objects and classify them */
+static void streamStage(Stream &stream, ClassificationService &service, const Parameters &params){
+	long index = 0;
+
+	while(true){
+		FramePtr ctx(new FrameContext());
+		ctx->index = index++;
+		if(!readFrame(stream.input, stream.grabber.get(), stream.replay.get(), stream.pool, *ctx, !isCameraSource(stream.source)))
+			break;
+		ctx->work = stream.scheduler.plan();
+		if(ctx->work != NO_DETECTION){
+			extractForeground(stream.subtractor, stream.filter, stream.gate, *ctx, stream.roi);
+			detectObjects(stream.detector, *ctx, stream.roi);
+		}
+		analyzeObjects(service, stream.tracker, *ctx, params);
+		if(!stream.analyzed.push(std::move(ctx)))
+			break;
+	}
+	stream.analyzed.close();
+}
+
+/* Analyze all the video sources listed in the configuration file. Each stream has its own background subtractor
+ * and its own tracks and runs on its own thread, while a single network classifies the objects found in all
+ * the streams: the classification service merges the objects submitted by the streams into the same batches */
+void analyzeVideoStreams(const Parameters &params){
+	vector< std::unique_ptr<Stream> > 	streams;		//Streams analyzed
+	vector<std::thread> 				analyzers;		//Analysis of each stream
+	FramePtr 							ctx;			//Frame to show
+	int 								active;			//Streams not yet over
+	int 								keyboard = 0; 	//Input from keyboard
+	std::unique_ptr<MetricsExporter> 	exporter = createMetricsExporter(params);	//Metrics served while the streams are analyzed
+
+	/* Load the net, mean image and labels, once for all the streams */
+	std::unique_ptr<Classifier> classifier = createClassifier(params);
+	ClassificationService service(*classifier, NUM_CLASSES, params.maxBatchSize, params.maxBatchWait);
+
+	//Set the frame dimensions
+	setFrameGeometry(params.sf, params.detectionLevel);
+
+	for(unsigned int i = 0; i < params.videoSources.size(); i++){
+		bool live = isLiveSource(params.videoSources[i], params);
+		streams.push_back(std::unique_ptr<Stream>(new Stream(params.videoSources[i], params.queueSize, live ? params.targetLatency : 0)));
+		Stream &stream = *streams.back();
+
+		//Open the video stream
+		if (!openStream(stream.input, stream.replay, stream.source)) {
+			cerr << "ERROR! Unable to open video stream " << stream.source << endl;
+			exit(EXIT_FAILURE);
+		}
+		//Latest frame wins on live streams
+		if(live)
+			stream.grabber.reset(new FrameGrabber(stream.input, !isCameraSource(stream.source)));
+
+		//Region of interest of the stream
+		stream.roi.build(params.roi, i, detectionSize);
+
+		//Create the background subtractor
+		stream.subtractor = createSubtractor(params);
+		stream.filter = createForegroundFilter(params);
+		stream.gate = createChangeGate(params);
+		stream.tracker = createTracker(params);
+
+		//Create a window to show the stream
+		namedWindow("Real time classification - " + stream.source, WINDOW_AUTOSIZE);
+		moveWindow("Real time classification - " + stream.source, 100 + 40 * i, 50 + 40 * i);
+	}
+
+	for(unsigned int i = 0; i < streams.size(); i++)
+		analyzers.push_back(std::thread(streamStage, std::ref(*streams[i]), std::ref(service), std::cref(params)));
+
+	//Show the frames ready on every stream, until ESC, q is pressed or all the streams are over. No stream is waited for,
+	//so a slow or stuck stream neither delays the others nor fills their queues
+	active = streams.size();
+	while(active > 0 && (char) keyboard != 'q' && (char) keyboard != 27){
+		active = 0;
+		for(unsigned int i = 0; i < streams.size(); i++){
+			if(!streams[i]->analyzed.drained())
+				active++;
+			if(!streams[i]->analyzed.tryPop(ctx))
+				continue;
+			imshow("Real time classification - " + streams[i]->source, ctx->overlay);
+			streams[i]->scheduler.done(*ctx);
+		}
+
+		//Acquire input from the keyboard
+		keyboard = waitKey(1);
+	}
+
+	//Stop the analysis of all the streams, the capture first: an analysis may be waiting for a frame
+	for(unsigned int i = 0; i < streams.size(); i++){
+		if(streams[i]->grabber)
+			streams[i]->grabber->stop();
+		streams[i]->analyzed.close();
+	}
+	for(unsigned int i = 0; i < analyzers.size(); i++)
+		analyzers[i].join();
+
+	for(unsigned int i = 0; i < streams.size(); i++){
+		//Release the input stream
+		streams[i]->input.release();
+		//Release the background subtractor
+		streams[i]->subtractor.release();
+	}
+	//Destroy the video windows
+	destroyAllWindows();
+
+	//Report the batches achieved by the classifier
+	service.stop();
+	if(params.classification)
+		service.printStatistics(cout);
+	//Report the frames the scheduler degraded or dropped to keep up with each live stream
+	for(unsigned int i = 0; i < streams.size(); i++){
+		if(!streams[i]->grabber)
+			continue;
+		cout << streams[i]->source << ": ";
+		streams[i]->scheduler.printStatistics(cout, streams[i]->grabber->dropped());
+	}
+}
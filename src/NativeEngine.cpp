@@ -0,0 +1,750 @@
+#include "../include/NativeEngine.hpp"
+#include "../include/TargetClones.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <math.h>
+#include <string.h>
+
+using namespace cv;
+
+#define NATIVE_TILE_PIXELS 		6		//Output pixels of a row computed together by the convolution
+#define NATIVE_TILE_BLOCKS 		2		//Output blocks computed together by the convolution
+#define NATIVE_ALIGN 			16		//Floats of a cache line, where the parameters of each layer start
+
+//Vectors of the NATIVE_LANES channels of a block, compiled to either AVX2/FMA or SSE registers
+typedef float Lanes __attribute__((vector_size(NATIVE_LANES * sizeof(float))));
+
+/* Message of the text format of protobuf (prototxt): the values and the nested messages of its fields, in order */
+struct ProtoMessage {
+	std::vector< std::pair<std::string, std::string> > values;
+	std::vector< std::pair<std::string, ProtoMessage> > messages;
+
+	/* First value of the field, or the default one if it is missing */
+	std::string value(const std::string &field, const std::string &otherwise = "") const{
+		for(size_t i = 0; i < values.size(); i++)
+			if(values[i].first.compare(field) == 0)
+				return values[i].second;
+		return otherwise;
+	}
+
+	int number(const std::string &field, int otherwise) const{
+		return atoi(value(field, std::to_string(otherwise)).c_str());
+	}
+
+	/* All the values of a repeated field */
+	std::vector<std::string> all(const std::string &field) const{
+		std::vector<std::string> found;
+		for(size_t i = 0; i < values.size(); i++)
+			if(values[i].first.compare(field) == 0)
+				found.push_back(values[i].second);
+		return found;
+	}
+
+	/* First nested message of the field, an empty one if it is missing */
+	const ProtoMessage &message(const std::string &field) const{
+		static const ProtoMessage empty;
+		for(size_t i = 0; i < messages.size(); i++)
+			if(messages[i].first.compare(field) == 0)
+				return messages[i].second;
+		return empty;
+	}
+};
+
+/* Next token of a prototxt: a name or a value, a quoted string without its quotes, or one of : { } */
+static bool nextToken(std::istream &in, std::string &token){
+	char c;
+
+	token.clear();
+	while(in.get(c)){
+		if(c == '#'){
+			while(in.get(c) && c != '\n');
+		}
+		else if(!isspace(c))
+			break;
+	}
+	if(!in)
+		return false;
+	if(c == ':' || c == '{' || c == '}'){
+		token = c;
+		return true;
+	}
+	if(c == '"' || c == '\''){
+		char quote = c;
+		while(in.get(c) && c != quote)
+			token += c;
+		return true;
+	}
+	token = c;
+	while(in.get(c)){
+		if(isspace(c) || c == ':' || c == '{' || c == '}' || c == '#'){
+			in.unget();
+			break;
+		}
+		token += c;
+	}
+	return true;
+}
+
+/* Parse the fields of a message up to its closing brace, or to the end of the file for the outermost one */
+static bool parseMessage(std::istream &in, ProtoMessage &message, bool nested){
+	std::string field, token;
+
+	while(nextToken(in, field)){
+		if(field.compare("}") == 0)
+			return nested;
+		if(!nextToken(in, token))
+			return false;
+		if(token.compare(":") == 0 && !nextToken(in, token))
+			return false;
+		if(token.compare("{") == 0){
+			message.messages.push_back(std::make_pair(field, ProtoMessage()));
+			if(!parseMessage(in, message.messages.back().second, true))
+				return false;
+		}
+		else
+			message.values.push_back(std::make_pair(field, token));
+	}
+	return !nested;
+}
+
+/* Field of a message in the protobuf wire format: its number, and its value (varint) or its bytes (any other type) */
+struct ProtoField {
+	int 			number;
+	int 			type;
+	uint64_t 		varint;
+	const uint8_t *	bytes;
+	size_t 			size;
+};
+
+/* Read the next field of a message, return false at its end */
+static bool readField(const uint8_t *&data, const uint8_t *end, ProtoField &field){
+	uint64_t key;
+
+	if(data >= end || !readVarint(data, end, key))
+		return false;
+	field.number = key >> 3;
+	field.type = key & 7;
+	if(field.type == 0)
+		return readVarint(data, end, field.varint);
+	if(field.type == 1)
+		field.size = 8;
+	else if(field.type == 5)
+		field.size = 4;
+	else if(field.type == 2){
+		if(!readVarint(data, end, field.varint))
+			return false;
+		field.size = field.varint;
+	}
+	else
+		return false;
+	if(field.size > (uint64_t)(end - data))
+		return false;
+	field.bytes = data;
+	data += field.size;
+	return true;
+}
+
+/* Read the weights of every layer from the caffemodel (a NetParameter in binary format), decoded directly:
+ * the layers (field 100, or 2 in the V1 format), with their name (field 1, or 4) and their blobs (field 7, or 6),
+ * each with its float data (field 5), either packed or repeated */
+static std::map<std::string, std::vector< std::vector<float> > > readWeights(const std::string &trained_file){
+	std::ifstream file(trained_file.c_str(), std::ios::binary);
+	if(!file){
+		std::cerr << "ERROR! Unable to open trained file " << trained_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::vector<uint8_t> message((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::map<std::string, std::vector< std::vector<float> > > weights;
+	const uint8_t *data = message.data(), *end = data + message.size();
+	ProtoField net, layer, blob;
+
+	while(readField(data, end, net)){
+		if(net.type != 2 || (net.number != 100 && net.number != 2))
+			continue;
+		bool legacy = net.number == 2;
+		const uint8_t *layerData = net.bytes, *layerEnd = net.bytes + net.size;
+		std::string name;
+		std::vector< std::vector<float> > blobs;
+
+		while(readField(layerData, layerEnd, layer)){
+			if(layer.type == 2 && layer.number == (legacy ? 4 : 1))
+				name.assign((const char *) layer.bytes, layer.size);
+			else if(layer.type == 2 && layer.number == (legacy ? 6 : 7)){
+				const uint8_t *blobData = layer.bytes, *blobEnd = layer.bytes + layer.size;
+				std::vector<float> values;
+				while(readField(blobData, blobEnd, blob)){
+					if(blob.number != 5 || (blob.type != 2 && blob.type != 5))
+						continue;
+					size_t first = values.size();
+					values.resize(first + blob.size / 4);
+					memcpy(&values[first], blob.bytes, blob.size / 4 * 4);
+				}
+				blobs.push_back(values);
+			}
+		}
+		if(!blobs.empty())
+			weights[name] = blobs;
+	}
+	if(data != end){
+		std::cerr << "ERROR! Unable to read trained file " << trained_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return weights;
+}
+
+static void unsupported(const std::string &layer, const std::string &reason){
+	std::cerr << "ERROR! Layer " << layer << " not supported by the native backend: " << reason << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+/* Read the layers of the net from the prototxt and their weights from the caffemodel. The weights are stored
+ * in the parameters in the order of the kernels, each layer starting on a cache line */
+NativeNet readNativeNet(const std::string &model_file, const std::string &trained_file, std::vector<float> &parameters){
+	std::ifstream model(model_file.c_str());
+	ProtoMessage prototxt;
+	NativeNet net;
+	if(!model || !parseMessage(model, prototxt, false)){
+		std::cerr << "ERROR! Unable to read " << model_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::map<std::string, std::vector< std::vector<float> > > weights = readWeights(trained_file);
+
+	//Input shape (num, channels, height, width), given as input_dim or as the dims of input_shape or of an Input layer
+	std::vector<std::string> shape = prototxt.all("input_dim");
+	std::string inputName = prototxt.value("input");
+	if(shape.empty())
+		shape = prototxt.message("input_shape").all("dim");
+	for(size_t l = 0; shape.empty() && l < prototxt.messages.size(); l++){
+		const ProtoMessage &layer = prototxt.messages[l].second;
+		if(prototxt.messages[l].first.compare("layer") == 0 && layer.value("type").compare("Input") == 0){
+			shape = layer.message("input_param").message("shape").all("dim");
+			inputName = layer.value("top");
+		}
+	}
+	if(shape.size() != 4){
+		std::cerr << "ERROR! Unable to read the input shape of " << model_file << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	net.input = net.addBlob(inputName, atoi(shape[1].c_str()), atoi(shape[2].c_str()), atoi(shape[3].c_str()));
+	net.output = net.input;
+
+	for(size_t l = 0; l < prototxt.messages.size(); l++){
+		if(prototxt.messages[l].first.compare("layer") != 0)
+			continue;
+		const ProtoMessage &layer = prototxt.messages[l].second;
+		std::string name = layer.value("name"), type = layer.value("type"), top = layer.value("top");
+		std::vector<std::string> bottoms = layer.all("bottom");
+
+		if(type.compare("Input") == 0)
+			continue;
+		if(bottoms.empty() || top.empty())
+			unsupported(name, "missing bottom or top");
+		int bottom = net.findBlob(bottoms[0]);
+		const NativeBuffer in = net.buffers[net.blobs[bottom].buffer];
+
+		if(type.compare("Convolution") == 0){
+			const ProtoMessage &param = layer.message("convolution_param");
+			NativeLayer conv;
+			int outputs = param.number("num_output", 0), channels = net.blobs[bottom].channels;
+			conv.type = NativeLayer::CONVOLUTION;
+			conv.kernel = param.number("kernel_size", param.number("kernel_h", 0));
+			conv.stride = param.number("stride", param.number("stride_h", 1));
+			conv.pad = param.number("pad", param.number("pad_h", 0));
+			conv.relu = false;
+			if(param.number("kernel_w", conv.kernel) != conv.kernel || param.number("stride_w", conv.stride) != conv.stride || param.number("pad_w", conv.pad) != conv.pad)
+				unsupported(name, "rectangular kernel");
+			if(param.number("group", 1) != 1 || param.number("dilation", 1) != 1)
+				unsupported(name, "grouped or dilated convolution");
+			if(conv.kernel < 1 || outputs < 1)
+				unsupported(name, "missing kernel_size or num_output");
+
+			//Weights from outputs x channels x kernel x kernel to blocks of output and input channels
+			const std::vector< std::vector<float> > &blobs = weights[name];
+			bool bias = param.value("bias_term", "true").compare("true") == 0;
+			if(blobs.size() != (bias ? 2u : 1u) || blobs[0].size() != (size_t) outputs * channels * conv.kernel * conv.kernel || (bias && blobs[1].size() != (size_t) outputs)){
+				std::cerr << "ERROR! Weights of layer " << name << " missing or not matching " << model_file << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			int outBlocks = (outputs + NATIVE_LANES - 1) / NATIVE_LANES, inBlocks = (channels + NATIVE_LANES - 1) / NATIVE_LANES;
+			int area = conv.kernel * conv.kernel;
+			conv.weights = parameters.size();
+			conv.bias = conv.weights + (size_t) outBlocks * inBlocks * area * NATIVE_LANES * NATIVE_LANES;
+			parameters.resize(conv.bias + outBlocks * NATIVE_LANES + NATIVE_ALIGN, 0);
+			parameters.resize(parameters.size() / NATIVE_ALIGN * NATIVE_ALIGN);
+			for(int o = 0; o < outputs; o++){
+				if(bias)
+					parameters[conv.bias + o] = blobs[1][o];
+				for(int c = 0; c < channels; c++)
+					for(int k = 0; k < area; k++)
+						parameters[conv.weights + ((((size_t) (o / NATIVE_LANES) * inBlocks + c / NATIVE_LANES) * area + k) * NATIVE_LANES + c % NATIVE_LANES) * NATIVE_LANES + o % NATIVE_LANES]
+							= blobs[0][((size_t) o * channels + c) * area + k];
+			}
+
+			//The padding is read from the border of the input
+			net.buffers[net.blobs[bottom].buffer].border = std::max(in.border, conv.pad);
+			conv.bottom = bottom;
+			conv.top = net.addBlob(top, outputs, (in.height + 2 * conv.pad - conv.kernel) / conv.stride + 1, (in.width + 2 * conv.pad - conv.kernel) / conv.stride + 1);
+			net.layers.push_back(conv);
+		}
+		else if(type.compare("ReLU") == 0){
+			if(top.compare(bottoms[0]) != 0 || net.layers.empty() || net.layers.back().type != NativeLayer::CONVOLUTION || net.layers.back().top != bottom || net.layers.back().relu)
+				unsupported(name, "ReLU not in place after a convolution");
+			if(atof(layer.message("relu_param").value("negative_slope", "0").c_str()) != 0)
+				unsupported(name, "leaky ReLU");
+			net.layers.back().relu = true;
+			continue;
+		}
+		else if(type.compare("Pooling") == 0){
+			const ProtoMessage &param = layer.message("pooling_param");
+			NativeLayer pool;
+			std::string method = param.value("pool", "MAX");
+			pool.type = method.compare("AVE") == 0 ? NativeLayer::AVE_POOLING : NativeLayer::MAX_POOLING;
+			pool.kernel = param.number("kernel_size", param.number("kernel_h", 0));
+			pool.stride = param.number("stride", param.number("stride_h", 1));
+			pool.pad = param.number("pad", param.number("pad_h", 0));
+			pool.relu = false;
+			pool.weights = pool.bias = 0;
+			if(method.compare("MAX") != 0 && method.compare("AVE") != 0)
+				unsupported(name, "pooling method " + method);
+			if(param.value("global_pooling").compare("true") == 0){
+				if(in.height != in.width)
+					unsupported(name, "global pooling of a rectangular input");
+				pool.kernel = in.height;
+				pool.stride = 1;
+				pool.pad = 0;
+			}
+			if(pool.kernel < 1 || param.number("kernel_w", pool.kernel) != pool.kernel || param.number("stride_w", pool.stride) != pool.stride || param.number("pad_w", pool.pad) != pool.pad)
+				unsupported(name, "missing or rectangular kernel");
+
+			//Output size of Caffe: the last window may start in the padding, but not after it
+			int height = (int) ceil((float) (in.height + 2 * pool.pad - pool.kernel) / pool.stride) + 1;
+			int width = (int) ceil((float) (in.width + 2 * pool.pad - pool.kernel) / pool.stride) + 1;
+			if(pool.pad > 0){
+				if((height - 1) * pool.stride >= in.height + pool.pad)
+					height--;
+				if((width - 1) * pool.stride >= in.width + pool.pad)
+					width--;
+			}
+			pool.bottom = bottom;
+			pool.top = net.addBlob(top, net.blobs[bottom].channels, height, width);
+			net.layers.push_back(pool);
+		}
+		else if(type.compare("Concat") == 0){
+			const ProtoMessage &param = layer.message("concat_param");
+			if(param.number("axis", param.number("concat_dim", 1)) != 1)
+				unsupported(name, "concatenation not along the channels");
+
+			//The inputs become consecutive blocks of the output, so every one but the last must fill its blocks
+			int channels = 0, border = 0;
+			for(size_t b = 0; b < bottoms.size(); b++){
+				const NativeBlob &blob = net.blobs[net.findBlob(bottoms[b])];
+				const NativeBuffer &buffer = net.buffers[blob.buffer];
+				if(blob.buffer == net.blobs[net.input].buffer || blob.firstBlock != 0 || buffer.blocks * NATIVE_LANES < blob.channels || buffer.blocks * NATIVE_LANES >= blob.channels + NATIVE_LANES)
+					unsupported(name, "input " + bottoms[b] + " shared with another concatenation or with the input");
+				if(buffer.height != in.height || buffer.width != in.width)
+					unsupported(name, "inputs of different sizes");
+				if(b + 1 < bottoms.size() && blob.channels % NATIVE_LANES != 0)
+					unsupported(name, "input " + bottoms[b] + " not made of whole blocks");
+				channels += blob.channels;
+				border = std::max(border, buffer.border);
+			}
+			int concat = net.addBlob(top, channels, in.height, in.width), firstBlock = 0;
+			net.buffers[net.blobs[concat].buffer].border = border;
+			for(size_t b = 0; b < bottoms.size(); b++){
+				int old = net.blobs[net.findBlob(bottoms[b])].buffer, blocks = net.buffers[old].blocks;
+				for(size_t i = 0; i < net.blobs.size(); i++){
+					if(net.blobs[i].buffer == old){
+						net.blobs[i].buffer = net.blobs[concat].buffer;
+						net.blobs[i].firstBlock += firstBlock;
+					}
+				}
+				net.buffers[old].blocks = 0;
+				firstBlock += blocks;
+			}
+			net.output = concat;
+			continue;
+		}
+		else if(type.compare("Dropout") == 0 || type.compare("Split") == 0){
+			//Same activations under the names of the tops
+			std::vector<std::string> tops = layer.all("top");
+			for(size_t t = 0; t < tops.size(); t++){
+				if(tops[t].compare(bottoms[0]) != 0){
+					NativeBlob alias = net.blobs[bottom];
+					alias.name = tops[t];
+					net.blobs.push_back(alias);
+				}
+			}
+			continue;
+		}
+		else if(type.compare("Softmax") == 0){
+			NativeLayer softmax;
+			if(layer.message("softmax_param").number("axis", 1) != 1)
+				unsupported(name, "softmax not along the channels");
+			softmax.type = NativeLayer::SOFTMAX;
+			softmax.kernel = softmax.stride = 1;
+			softmax.pad = 0;
+			softmax.relu = false;
+			softmax.weights = softmax.bias = 0;
+			softmax.bottom = bottom;
+			softmax.top = net.addBlob(top, net.blobs[bottom].channels, in.height, in.width);
+			net.layers.push_back(softmax);
+		}
+		else
+			unsupported(name, "type " + type);
+
+		if(top.compare(bottoms[0]) == 0)
+			unsupported(name, "computed in place");
+		net.output = net.layers.back().top;
+	}
+
+	return net;
+}
+
+/* Add the output of a layer, in a buffer of its own */
+int NativeNet::addBlob(const std::string &name, int channels, int height, int width){
+	NativeBuffer buffer;
+	NativeBlob blob;
+
+	if(channels < 1 || height < 1 || width < 1)
+		unsupported(name, "empty output");
+	buffer.blocks = (channels + NATIVE_LANES - 1) / NATIVE_LANES;
+	buffer.height = height;
+	buffer.width = width;
+	buffer.border = 0;
+	blob.name = name;
+	blob.buffer = buffers.size();
+	blob.firstBlock = 0;
+	blob.channels = channels;
+	buffers.push_back(buffer);
+	blobs.push_back(blob);
+	return blobs.size() - 1;
+}
+
+/* Latest blob with the given name, the tops of the layers computed in place replace their bottoms */
+int NativeNet::findBlob(const std::string &name) const{
+	for(int i = blobs.size() - 1; i >= 0; i--)
+		if(blobs[i].name.compare(name) == 0)
+			return i;
+	unsupported(name, "unknown bottom");
+	return -1;
+}
+
+int NativeNet::outputSize() const{
+	const NativeBuffer &buffer = buffers[blobs[output].buffer];
+	return blobs[output].channels * buffer.height * buffer.width;
+}
+
+/* Input geometry of the net */
+Size NativeNet::geometry() const{
+	const NativeBuffer &buffer = buffers[blobs[input].buffer];
+	return Size(buffer.width, buffer.height);
+}
+
+/* Load the layers and the weights of the net from the Caffe files */
+NativeEngine::NativeEngine(const std::string &model_file, const std::string &trained_file, const std::vector<int> &batchSizes)
+	: sizes_(batchSizes) {
+
+	net_ = readNativeNet(model_file, trained_file, ownParameters_);
+	parameters_ = ownParameters_.data();
+	allocate();
+}
+
+/* Run a net whose parameters are kept by the caller, as long as the engine */
+NativeEngine::NativeEngine(const NativeNet &net, const float *parameters, const std::vector<int> &batchSizes)
+	: net_(net), parameters_(parameters), sizes_(batchSizes) {
+
+	allocate();
+}
+
+std::unique_ptr<InferenceEngine> NativeEngine::replicate() const{
+	return std::unique_ptr<InferenceEngine>(new NativeEngine(net_, parameters_, sizes_));
+}
+
+/* Input and output of each batch size */
+void NativeEngine::allocate(){
+	for(size_t i = 0; i < sizes_.size(); i++){
+		inputs_.push_back(std::vector<float>((size_t) sizes_[i] * inputChannels() * net_.geometry().area(), 0));
+		outputs_.push_back(std::vector<float>((size_t) sizes_[i] * outputSize(), 0));
+	}
+}
+
+/* Position of the batch size */
+int NativeEngine::index(int size) const{
+	for(size_t i = 0; i < sizes_.size(); i++)
+		if(sizes_[i] == size)
+			return i;
+	std::cerr << "ERROR! No input for batches of " << size << " images" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+float *NativeEngine::input(int size){
+	return &inputs_[index(size)][0];
+}
+
+/* Pixels of a blob in a workspace: the origin is the first pixel of the first block, inside the border */
+struct BlobView {
+	float *		origin;
+	ptrdiff_t 	blockStep;		//Floats between two blocks
+	ptrdiff_t 	rowStep;		//Floats between two rows
+	int 		blocks;
+	int 		channels;
+	int 		height;
+	int 		width;
+};
+
+static BlobView view(const NativeBlob &blob, const NativeBuffer &buffer, std::vector<float> &memory){
+	BlobView view;
+	view.rowStep = (ptrdiff_t) (buffer.width + 2 * buffer.border) * NATIVE_LANES;
+	view.blockStep = (buffer.height + 2 * buffer.border) * view.rowStep;
+	view.origin = &memory[0] + blob.firstBlock * view.blockStep + buffer.border * (view.rowStep + NATIVE_LANES);
+	view.channels = blob.channels;
+	view.blocks = (blob.channels + NATIVE_LANES - 1) / NATIVE_LANES;
+	view.height = buffer.height;
+	view.width = buffer.width;
+	return view;
+}
+
+//Vectors are passed by reference, their ABI depends on the instruction set
+static KERNEL_INLINE void loadLanes(Lanes &lanes, const float *values){
+	memcpy(&lanes, values, sizeof(lanes));
+}
+
+static KERNEL_INLINE void storeLanes(float *values, const Lanes &lanes){
+	memcpy(values, &lanes, sizeof(lanes));
+}
+
+/* Add the products of the input channels of a pixel with their weights to the sums of BLOCKS output blocks of PIXELS pixels:
+ * each input value is broadcast and multiplied with the weights of NATIVE_LANES output channels at a time */
+template<int BLOCKS, int PIXELS>
+static KERNEL_INLINE void accumulate(Lanes (&sums)[BLOCKS][PIXELS], const float *pixel, ptrdiff_t pixelStep, const float *weights, size_t filterStep, int lanes){
+	for(int i = 0; i < lanes; i++){
+		Lanes w[BLOCKS];
+		for(int b = 0; b < BLOCKS; b++)
+			loadLanes(w[b], weights + b * filterStep + i * NATIVE_LANES);
+		for(int p = 0; p < PIXELS; p++){
+			float value = pixel[p * pixelStep + i];
+			for(int b = 0; b < BLOCKS; b++)
+				sums[b][p] += w[b] * value;
+		}
+	}
+}
+
+/* Convolution of PIXELS consecutive output pixels of a row, for BLOCKS output blocks. The kernel size is a constant
+ * for the 1x1 and 3x3 convolutions of the fire modules (KERNEL), or read from the layer for any other (KERNEL = 0) */
+template<int KERNEL, int BLOCKS, int PIXELS>
+static KERNEL_INLINE void convolveTile(const NativeLayer &layer, const float *parameters, const BlobView &in, const BlobView &out, int block, int y, int x){
+	const int kernel = KERNEL > 0 ? KERNEL : layer.kernel;
+	const size_t filterStep = (size_t) in.blocks * kernel * kernel * NATIVE_LANES * NATIVE_LANES;	//Weights of an output block
+	const ptrdiff_t pixelStep = layer.stride * NATIVE_LANES;
+	const float *weights = parameters + layer.weights + block * filterStep;
+	Lanes sums[BLOCKS][PIXELS];
+
+	for(int b = 0; b < BLOCKS; b++){
+		Lanes bias;
+		loadLanes(bias, parameters + layer.bias + (block + b) * NATIVE_LANES);
+		for(int p = 0; p < PIXELS; p++)
+			sums[b][p] = bias;
+	}
+	for(int ib = 0; ib < in.blocks; ib++){
+		int lanes = std::min(NATIVE_LANES, in.channels - ib * NATIVE_LANES);
+		const float *window = in.origin + ib * in.blockStep + (y * layer.stride - layer.pad) * in.rowStep + (x * layer.stride - layer.pad) * NATIVE_LANES;
+		for(int ky = 0; ky < kernel; ky++){
+			for(int kx = 0; kx < kernel; kx++, weights += NATIVE_LANES * NATIVE_LANES){
+				//Full blocks with a constant number of lanes, so that their loop is unrolled
+				if(lanes == NATIVE_LANES)
+					accumulate<BLOCKS, PIXELS>(sums, window + ky * in.rowStep + kx * NATIVE_LANES, pixelStep, weights, filterStep, NATIVE_LANES);
+				else
+					accumulate<BLOCKS, PIXELS>(sums, window + ky * in.rowStep + kx * NATIVE_LANES, pixelStep, weights, filterStep, lanes);
+			}
+		}
+	}
+
+	const Lanes zero = {};
+	for(int b = 0; b < BLOCKS; b++){
+		float *pixel = out.origin + (block + b) * out.blockStep + y * out.rowStep + x * NATIVE_LANES;
+		for(int p = 0; p < PIXELS; p++)
+			storeLanes(pixel + p * NATIVE_LANES, layer.relu ? (sums[b][p] > zero ? sums[b][p] : zero) : sums[b][p]);
+	}
+}
+
+template<int KERNEL, int BLOCKS>
+static KERNEL_INLINE void convolveRow(const NativeLayer &layer, const float *parameters, const BlobView &in, const BlobView &out, int block, int y){
+	int x = 0;
+	for(; x + NATIVE_TILE_PIXELS <= out.width; x += NATIVE_TILE_PIXELS)
+		convolveTile<KERNEL, BLOCKS, NATIVE_TILE_PIXELS>(layer, parameters, in, out, block, y, x);
+	for(; x < out.width; x++)
+		convolveTile<KERNEL, BLOCKS, 1>(layer, parameters, in, out, block, y, x);
+}
+
+template<int KERNEL>
+static KERNEL_INLINE void convolveBlocks(const NativeLayer &layer, const float *parameters, const BlobView &in, const BlobView &out){
+	int block = 0;
+	for(; block + NATIVE_TILE_BLOCKS <= out.blocks; block += NATIVE_TILE_BLOCKS)
+		for(int y = 0; y < out.height; y++)
+			convolveRow<KERNEL, NATIVE_TILE_BLOCKS>(layer, parameters, in, out, block, y);
+	for(; block < out.blocks; block++)
+		for(int y = 0; y < out.height; y++)
+			convolveRow<KERNEL, 1>(layer, parameters, in, out, block, y);
+}
+
+/* Direct convolution, with the ReLU applied before the output is stored. The input is read in its border
+ * for the padding, and the output is written in its blocks of the buffer, which makes the concatenation */
+KERNEL_TARGETS
+static void convolve(const NativeLayer &layer, const float *parameters, const BlobView &in, const BlobView &out){
+	if(layer.kernel == 1)
+		convolveBlocks<1>(layer, parameters, in, out);
+	else if(layer.kernel == 3)
+		convolveBlocks<3>(layer, parameters, in, out);
+	else
+		convolveBlocks<0>(layer, parameters, in, out);
+}
+
+/* Pooling as in Caffe: the maximum of the window clipped to the input, or the average over the window clipped
+ * to the padded input, whose padding counts as zeros */
+KERNEL_TARGETS
+static void pool(const NativeLayer &layer, const BlobView &in, const BlobView &out){
+	for(int block = 0; block < out.blocks; block++){
+		for(int y = 0; y < out.height; y++){
+			int top = y * layer.stride - layer.pad, bottom = std::min(top + layer.kernel, in.height + layer.pad);
+			int rows = bottom - top;
+			top = std::max(top, 0);
+			bottom = std::min(bottom, in.height);
+			for(int x = 0; x < out.width; x++){
+				int left = x * layer.stride - layer.pad, right = std::min(left + layer.kernel, in.width + layer.pad);
+				int area = rows * (right - left);
+				left = std::max(left, 0);
+				right = std::min(right, in.width);
+
+				const float *row = in.origin + block * in.blockStep + top * in.rowStep;
+				Lanes result = {};
+				if(layer.type == NativeLayer::MAX_POOLING){
+					loadLanes(result, row + left * NATIVE_LANES);
+					for(int i = top; i < bottom; i++, row += in.rowStep)
+						for(int j = left; j < right; j++){
+							Lanes value;
+							loadLanes(value, row + j * NATIVE_LANES);
+							result = value > result ? value : result;
+						}
+				}
+				else{
+					for(int i = top; i < bottom; i++, row += in.rowStep)
+						for(int j = left; j < right; j++){
+							Lanes value;
+							loadLanes(value, row + j * NATIVE_LANES);
+							result += value;
+						}
+					result /= (float) area;
+				}
+				storeLanes(out.origin + block * out.blockStep + y * out.rowStep + x * NATIVE_LANES, result);
+			}
+		}
+	}
+}
+
+/* Softmax of the channels of each pixel */
+static void softmax(const BlobView &in, const BlobView &out){
+	for(int y = 0; y < in.height; y++){
+		for(int x = 0; x < in.width; x++){
+			const float *pixel = in.origin + y * in.rowStep + x * NATIVE_LANES;
+			float *result = out.origin + y * out.rowStep + x * NATIVE_LANES;
+			float maximum = pixel[0], sum = 0;
+			for(int c = 1; c < in.channels; c++)
+				maximum = std::max(maximum, pixel[c / NATIVE_LANES * in.blockStep + c % NATIVE_LANES]);
+			for(int c = 0; c < in.channels; c++){
+				float value = expf(pixel[c / NATIVE_LANES * in.blockStep + c % NATIVE_LANES] - maximum);
+				result[c / NATIVE_LANES * out.blockStep + c % NATIVE_LANES] = value;
+				sum += value;
+			}
+			for(int c = 0; c < in.channels; c++)
+				result[c / NATIVE_LANES * out.blockStep + c % NATIVE_LANES] /= sum;
+		}
+	}
+}
+
+/* Run the net on one image, from the planar input to the planar output */
+void NativeEngine::forwardImage(const float *image, float *output, std::vector< std::vector<float> > &workspace) const{
+	//Planes to blocks of channels
+	BlobView in = view(net_.blobs[net_.input], net_.buffers[net_.blobs[net_.input].buffer], workspace[net_.blobs[net_.input].buffer]);
+	for(int c = 0; c < in.channels; c++)
+		for(int y = 0; y < in.height; y++)
+			for(int x = 0; x < in.width; x++)
+				in.origin[c / NATIVE_LANES * in.blockStep + y * in.rowStep + x * NATIVE_LANES + c % NATIVE_LANES] = *image++;
+
+	for(size_t l = 0; l < net_.layers.size(); l++){
+		const NativeLayer &layer = net_.layers[l];
+		const NativeBlob &bottom = net_.blobs[layer.bottom], &top = net_.blobs[layer.top];
+		BlobView from = view(bottom, net_.buffers[bottom.buffer], workspace[bottom.buffer]);
+		BlobView to = view(top, net_.buffers[top.buffer], workspace[top.buffer]);
+		if(layer.type == NativeLayer::CONVOLUTION)
+			convolve(layer, parameters_, from, to);
+		else if(layer.type == NativeLayer::SOFTMAX)
+			softmax(from, to);
+		else
+			pool(layer, from, to);
+	}
+
+	//Blocks of channels to planes
+	BlobView out = view(net_.blobs[net_.output], net_.buffers[net_.blobs[net_.output].buffer], workspace[net_.blobs[net_.output].buffer]);
+	for(int c = 0; c < out.channels; c++)
+		for(int y = 0; y < out.height; y++)
+			for(int x = 0; x < out.width; x++)
+				*output++ = out.origin[c / NATIVE_LANES * out.blockStep + y * out.rowStep + x * NATIVE_LANES + c % NATIVE_LANES];
+}
+
+/* Workspace of a thread, a new one if all of them are in use. The borders are zeroed once, since only
+ * the pixels inside them are ever written */
+std::vector< std::vector<float> > NativeEngine::acquireWorkspace(){
+	std::vector< std::vector<float> > workspace;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(!workspaces_.empty()){
+			workspace.swap(workspaces_.back());
+			workspaces_.pop_back();
+			return workspace;
+		}
+	}
+	for(size_t i = 0; i < net_.buffers.size(); i++){
+		const NativeBuffer &buffer = net_.buffers[i];
+		workspace.push_back(std::vector<float>((size_t) buffer.blocks * (buffer.height + 2 * buffer.border) * (buffer.width + 2 * buffer.border) * NATIVE_LANES, 0));
+	}
+	return workspace;
+}
+
+void NativeEngine::releaseWorkspace(std::vector< std::vector<float> > &workspace){
+	std::lock_guard<std::mutex> lock(mutex_);
+	workspaces_.push_back(std::vector< std::vector<float> >());
+	workspaces_.back().swap(workspace);
+}
+
+/* Images of a batch, run in parallel with the other ones */
+class NativeBody : public ParallelLoopBody {
+
+	private:
+		NativeEngine &	engine_;
+		const float *	inputs_;
+		float *			outputs_;
+		size_t 			inputSize_;
+		size_t 			outputSize_;
+
+	public:
+		NativeBody(NativeEngine &engine, const float *inputs, float *outputs, size_t inputSize, size_t outputSize)
+			: engine_(engine), inputs_(inputs), outputs_(outputs), inputSize_(inputSize), outputSize_(outputSize) {}
+
+		void operator()(const Range &images) const{
+			std::vector< std::vector<float> > workspace = engine_.acquireWorkspace();
+			for(int i = images.start; i < images.end; i++)
+				engine_.forwardImage(inputs_ + i * inputSize_, outputs_ + i * outputSize_, workspace);
+			engine_.releaseWorkspace(workspace);
+		}
+};
+
+const float *NativeEngine::forward(int size){
+	int i = index(size);
+	size_t inputSize = (size_t) inputChannels() * net_.geometry().area();
+
+	parallel_for_(Range(0, size), NativeBody(*this, &inputs_[i][0], &outputs_[i][0], inputSize, outputSize()), size);
+	return &outputs_[i][0];
+}
@@ -0,0 +1,533 @@
+
+#include "../include/Pipeline.hpp"
+#include <thread>
+
+int 	frameWidth;		//Frame width
+int 	frameHeight;	//Frame height
+float 	frameDiagonal;	//Diagonal of the frame
+int 	detectionLevel;	//Pyramid level of the frame where the moving objects are detected
+Size 	detectionSize;	//Size of the frame where the moving objects are detected
+
+Scalar recColors [8] = { Scalar(0, 255, 0), 	//Green
+						 Scalar(203, 192, 255),	//Pink
+						 Scalar(0, 0, 255),		//Red
+						 Scalar(0, 153, 255),	//Orange
+						 Scalar(0, 216, 255),	//Yellow
+						 Scalar(255, 127, 0),	//Azure
+						 Scalar(255, 0, 0),		//Blue
+						 Scalar(92, 11, 227) };	//Raspberry
+
+/* Set the frame dimensions given the scaling factor (Maintain 16:9 aspect ratio).
+ * Moving objects are detected on the frame halved level times, then they are cut from the whole frame */
+void setFrameGeometry(int sf, int level){
+	frameWidth = 16 * sf;
+	frameHeight = 9 * sf;
+	//Set the diagonal of the frame
+	frameDiagonal = sqrt(pow(frameWidth, 2) + pow(frameHeight, 2));
+	//Set the detection frame
+	detectionLevel = level;
+	detectionSize = Size(frameWidth >> level, frameHeight >> level);
+}
+
+/* Side of a square kernel, given for the whole frame, scaled to the detection frame (odd and at least 3) */
+int detectionKernelSize(int size){
+	return std::max(3, (size >> detectionLevel) | 1);
+}
+
+/* Check if the rectangle around the object touches the border of the frame where it was found.
+ * Objects one pixel away from the border are rejected too, as were the ones of the contours, which did not include the border pixels */
+bool notBorderObject(Rect rec, Size frameSize){
+
+	Point topLeft = rec.tl();
+	Point bottomRight = rec.br();
+
+	if(topLeft.x <= 1 || topLeft.y <= 1 || bottomRight.x >= frameSize.width - 1 || bottomRight.y >= frameSize.height - 1)
+		return false;
+
+	return true;
+}
+
+/* Avoid really small objects founded. This objects are difficult to label for the ground truth
+ * The minimum sides are relative to the height of the frame where the object was found */
+bool checkDimension(Rect rec, Size frameSize){
+	//Size as to be greater than or equal to 40x15 or 15x40 on a 1280x720 frame (sides compared as fractions of the height)
+	int width = rec.width * REFERENCE_HEIGHT;
+	int height = rec.height * REFERENCE_HEIGHT;
+	int minSide = MIN_OBJECT_SIDE * frameSize.height;
+	int minLongSide = MIN_OBJECT_LONG_SIDE * frameSize.height;
+	if((width < minSide || height < minSide) || (width < minLongSide && height < minLongSide))
+		return false;
+
+	return true;
+}
+
+/* Check if the source is a camera: either empty (default camera) or the index of a device */
+bool isCameraSource(const string &source){
+	for(unsigned int i = 0; i < source.size(); i++)
+		if(!isdigit(source[i]))
+			return false;
+	return true;
+}
+
+/* Check if the source is analyzed live: cameras always, video files only when paced in real time, replays never */
+bool isLiveSource(const string &source, const Parameters &params){
+	return (isCameraSource(source) || params.realTime) && !FrameReplay::isReplay(source);
+}
+
+/* Open a video file or a camera */
+bool openStream(VideoCapture &input, const string &source){
+	if(source.compare("") == 0)
+		input.open(CV_CAP_ANY); //Acquire from the default camera
+	else if(isCameraSource(source))
+		input.open(atoi(source.c_str())); //Acquire from the given camera
+	else
+		input.open(source); //Acquire from a video
+	return input.isOpened();
+}
+
+/* Resize the frame to the detection frame and copy it to the overlay, both taken from the buffers of the pool */
+static void prepareFrame(FramePool &pool, FrameContext &ctx){
+	if(detectionLevel > 0){
+		ctx.small = pool.acquire(detectionSize, CV_8UC3);
+		resize(ctx.frame, ctx.small, detectionSize, 0, 0, INTER_AREA);
+	}
+	else
+		ctx.small = ctx.frame;
+
+	//Annotations never touch the frame, whose pixels the objects may still be classified from
+	ctx.overlay = pool.acquire(ctx.frame.size(), CV_8UC3);
+	ctx.frame.copyTo(ctx.overlay);
+}
+
+/* Resize the frame decoded to the analyzed frame (Maintain 16:9 aspect ratio), taken from the buffers of the pool
+ * instead of being allocated for each frame */
+static void resizeFrame(FramePool &pool, FrameContext &ctx){
+	ctx.frame = pool.acquire(Size(frameWidth, frameHeight), CV_8UC3);
+	resize(pool.decoded(), ctx.frame, ctx.frame.size(), 0, 0, INTER_LINEAR);
+	prepareFrame(pool, ctx);
+}
+
+/* Read the next frame of the stream and resize it. Return false when the video is over */
+bool readFrame(VideoCapture &input, FramePool &pool, FrameContext &ctx, bool fromVideo, Profiler *profiler){
+	StageTimer timer(profiler);
+	ctx.captured = std::chrono::steady_clock::now();
+
+	//Read the current frame (BGR color-space), a video is over when no frame is left
+	if (!input.read(pool.decoded())) {
+		if(fromVideo)
+			return false;
+		cerr << "Unable to read next frame." << endl;
+		cerr << "Exiting..." << endl;
+		exit(EXIT_FAILURE);
+	}
+	timer.lap("decode");
+
+	resizeFrame(pool, ctx);
+	timer.lap("resize");
+
+	return true;
+}
+
+/* Take the latest frame captured from a live stream and resize it. Return false when the stream is over */
+bool readFrame(FrameGrabber &grabber, FramePool &pool, FrameContext &ctx, Profiler *profiler){
+	StageTimer timer(profiler);
+
+	//Wait for a frame not analyzed yet, the older ones have been dropped
+	if(!grabber.next(ctx, pool.decoded()))
+		return false;
+	timer.lap("decode");
+
+	resizeFrame(pool, ctx);
+	timer.lap("resize");
+
+	return true;
+}
+
+/* Take the next frame of a replay. A frame recorded at the size of the analyzed frame is used in place, as a view
+ * of the replay, otherwise it is resized. Return false when the replay is over */
+bool readFrame(FrameReplay &replay, FramePool &pool, FrameContext &ctx, Profiler *profiler){
+	StageTimer timer(profiler);
+	Mat recorded;
+	ctx.captured = std::chrono::steady_clock::now();
+
+	if(!replay.next(recorded))
+		return false;
+	timer.lap("decode");
+
+	if(recorded.size() == Size(frameWidth, frameHeight))
+		ctx.frame = recorded;
+	else{
+		ctx.frame = pool.acquire(Size(frameWidth, frameHeight), CV_8UC3);
+		resize(recorded, ctx.frame, ctx.frame.size(), 0, 0, INTER_LINEAR);
+	}
+	prepareFrame(pool, ctx);
+	timer.lap("resize");
+
+	return true;
+}
+
+/* Read the next frame of a stream: from its replay if it has one, from its capture thread if it is live,
+ * otherwise from the stream itself */
+bool readFrame(VideoCapture &input, FrameGrabber *grabber, FrameReplay *replay, FramePool &pool, FrameContext &ctx, bool fromVideo, Profiler *profiler){
+	if(replay)
+		return readFrame(*replay, pool, ctx, profiler);
+	if(grabber)
+		return readFrame(*grabber, pool, ctx, profiler);
+	return readFrame(input, pool, ctx, fromVideo, profiler);
+}
+
+/* Open the source of a stream: a replay recorded with --record-frames, a video file or a camera */
+bool openStream(VideoCapture &input, std::unique_ptr<FrameReplay> &replay, const string &source){
+	if(FrameReplay::isReplay(source)){
+		replay.reset(new FrameReplay(source));
+		return true;
+	}
+	return openStream(input, source);
+}
+
+/* Load the net, its mean values and labels: from the bundle of the configuration file if any, otherwise from the net path */
+std::unique_ptr<Classifier> createClassifier(const Parameters &params){
+	if(params.bundlePath.compare("") != 0)
+		return std::unique_ptr<Classifier>(new Classifier(params.bundlePath, params.maxBatchSize, params.replicas));
+	return std::unique_ptr<Classifier>(new Classifier(params.netPath + "/deploy.prototxt", params.netPath + "/deploy.caffemodel", params.netPath + "/mean.binaryproto", params.netPath + "/labels.txt", false, params.maxBatchSize, params.backend, params.replicas));
+}
+
+/* Enable the metrics and start exporting them, if the configuration file asks for any export */
+std::unique_ptr<MetricsExporter> createMetricsExporter(const Parameters &params){
+	if(params.metricsPort == 0 && params.metricsSocket.compare("") == 0 && params.metricsSnapshot.compare("") == 0)
+		return std::unique_ptr<MetricsExporter>();
+	metrics.enable();
+	return std::unique_ptr<MetricsExporter>(new MetricsExporter(params.metricsPort, params.metricsSocket, params.metricsSnapshot, params.metricsInterval));
+}
+
+/* Create the background subtractor selected in the configuration file */
+Ptr<BackgroundSubtractor> createSubtractor(const Parameters &params){
+	if(params.subtractor.compare("mixture") == 0)
+		return makePtr<MixtureSubtractor>(500, 16, params.learningRate);
+
+	Ptr<BackgroundSubtractorMOG2> mog2 = createBackgroundSubtractorMOG2();
+	//No shadow detection
+	mog2->setDetectShadows(false);
+	return mog2;
+}
+
+/* Create the blur and morphology kernels of the configuration file, scaled to the detection frame */
+ForegroundFilter createForegroundFilter(const Parameters &params){
+	return ForegroundFilter(detectionKernelSize(params.blurSize), detectionKernelSize(params.dilateSize), detectionKernelSize(params.erodeSize));
+}
+
+/* Create the gate of the global changes of the scene, with the threshold of the configuration file. Out of the
+ * recovery from a change, the gate gives the subtractor the learning rate of the configuration file */
+ChangeGate createChangeGate(const Parameters &params){
+	return ChangeGate(params.globalChangeTH, params.learningRate);
+}
+
+/* Create the tracks of a stream, with the motion model of the configuration file */
+Tracker createTracker(const Parameters &params){
+	return Tracker(params.motionModel.compare("kalman") == 0);
+}
+
+/* Compute the foreground mask of the detection frame. Only the bounds of the region of interest are processed,
+ * the rest of the mask is background. When the gate finds a global change in the raw mask, nothing else is done:
+ * the frame is marked and no objects will be searched in it */
+void extractForeground(Ptr<BackgroundSubtractor> subtractor, ForegroundFilter &filter, ChangeGate &gate, FrameContext &ctx, const RegionOfInterest &roi, Profiler *profiler){
+	StageTimer timer(profiler);
+	Mat blur;		//Frame with some noise removed
+	Mat foreground;	//Foreground mask within the bounds
+	bool wholeFrame = roi.bounds() == Rect(Point(0, 0), ctx.small.size());
+
+	//Blur applied to eliminate some noise
+	filter.blur(Mat(ctx.small, roi.bounds()), blur);
+	timer.lap("blur");
+
+	//Mixture of Gaussian subtractor applied to the current frame, learning faster after a global change
+	subtractor->apply(blur, foreground, gate.learningRate());
+	timer.lap("subtraction");
+
+	//Most of the frame is foreground: a change of the lighting rather than moving objects
+	ctx.globalChange = gate.changed(foreground);
+	timer.lap("change_gate");
+	if(ctx.globalChange)
+		return;
+
+	//Close the holes of the foreground mask: dilation, then erosion
+	filter.close(foreground, foreground);
+
+	if(wholeFrame){
+		ctx.mask = foreground;
+	}
+	else{
+		ctx.mask = Mat::zeros(ctx.small.size(), CV_8U);
+		foreground.copyTo(Mat(ctx.mask, roi.bounds()));
+	}
+	timer.lap("morphology");
+}
+
+/* Given the connected components of the detection frame, found the relative objects and return the number of objects founded.
+ * Objects whose center is outside the region of interest are discarded.
+ * Rectangles and centers of mass are mapped back to the whole frame, where the objects are cut from */
+int findObjects(FrameContext &ctx, const vector<ForegroundBlob> &blobs, const RegionOfInterest &roi){
+	int objects = 0;
+
+	//Clean structures
+	ctx.recs.clear();
+	ctx.boundingBoxes.clear();
+	ctx.predictions.clear();
+	ctx.massCenters.clear();
+	ctx.colors.clear();
+
+	int scale = 1 << detectionLevel;
+	Rect frameRect(0, 0, ctx.frame.cols, ctx.frame.rows);
+
+	//Scan each region found
+	for (unsigned int i = 0; i < blobs.size(); i++) {
+		//Rectangle around the object
+		Rect aux = blobs[i].box;
+		if(!roi.empty() && !roi.contains(Point(aux.x + aux.width / 2, aux.y + aux.height / 2)))
+			continue;
+		/* Consider only rectangles with area greater than a given threshold and that are not border objects
+		 * This allows to avoid classifying very small objects and partial objects
+		 */
+		if (checkDimension(aux, ctx.small.size()) && notBorderObject(aux, ctx.small.size())){
+			ctx.recs.push_back(Rect(aux.x * scale, aux.y * scale, aux.width * scale, aux.height * scale) & frameRect);
+			ctx.boundingBoxes.push_back(Mat(ctx.frame, ctx.recs.back()));
+			//Center of mass of the object, a detection pixel covers scale x scale pixels of the frame
+			Point2f massCenter = blobs[i].centroid;
+			ctx.massCenters.push_back(Point2f(massCenter.x * scale + (scale - 1) / 2.f, massCenter.y * scale + (scale - 1) / 2.f));
+			objects++;
+		}
+	}
+	return objects;
+}
+
+/* Find the moving objects in the foreground mask and return the number of objects founded */
+int detectObjects(BlobDetector &detector, FrameContext &ctx, const RegionOfInterest &roi, Profiler *profiler){
+	StageTimer timer(profiler);
+
+	//No mask after a global change: the frame has no objects
+	if(ctx.globalChange){
+		metrics.count(FRAMES_GLOBAL_CHANGE);
+		return ctx.objects = findObjects(ctx, vector<ForegroundBlob>(), roi);
+	}
+
+	//Find the connected components of the foreground mask, with their rectangles and centers of mass
+	const vector<ForegroundBlob> &blobs = detector.detect(Mat(ctx.mask, roi.bounds()), roi.bounds().tl());
+	timer.lap("components");
+
+	//Keep the components that can be objects
+	ctx.objects = findObjects(ctx, blobs, roi);
+	timer.lap("find_objects");
+	metrics.observe(OBJECTS_PER_FRAME, ctx.objects);
+	return ctx.objects;
+}
+
+/* Classify objects when the tracking mode is off */
+void classifyObjects(ClassificationService &service, FrameContext &ctx, float probTH, Profiler *profiler){
+	//If there is at least one founded object
+	if(ctx.boundingBoxes.size() > 0){
+
+		//classify and wait for the predictions
+		ctx.predictions = service.classify(ctx.boundingBoxes);
+	}
+
+	StageTimer timer(profiler);
+	drawPredictions(ctx, probTH);
+	timer.lap("draw");
+}
+
+/* Draw the objects classified with a sufficient probability */
+void drawPredictions(FrameContext &ctx, float probTH){
+	String guess;
+	float prob;
+	int baseline;
+	for(unsigned int i = 0; i < ctx.recs.size(); i++){
+		guess = ctx.predictions.at(i).at(0).first;
+		prob  = ctx.predictions.at(i).at(0).second;
+		if(prob >= probTH && strToEnum(guess) != background){
+			Size textSize = getTextSize(guess, FONT_HERSHEY_PLAIN, 1.0, 1, &baseline);
+			rectangle(ctx.overlay, ctx.recs.at(i).tl() - Point(1, 1), ctx.recs.at(i).tl() + Point(textSize.width, -(textSize.height + 6)), recColors[strToEnum(guess)], CV_FILLED);
+			putText(ctx.overlay, guess, Point(ctx.recs.at(i).x, ctx.recs.at(i).y - 4), FONT_HERSHEY_PLAIN, 1.0, Scalar(0,0,0), 1);
+			rectangle(ctx.overlay, ctx.recs.at(i).br(), ctx.recs.at(i).tl(), recColors[strToEnum(guess)], 2);
+		}
+	}
+}
+
+/* Draw only the rectangles of the objects, without classification */
+void drawObjects(FrameContext &ctx){
+	for(unsigned int i = 0; i < ctx.recs.size(); i++){
+		rectangle(ctx.overlay, ctx.recs.at(i).br(), ctx.recs.at(i).tl(), recColors[0], 2);
+	}
+}
+
+/* Classify objects when tracking mode is on */
+void classifyObjectsWithTracking(ClassificationService &service, Tracker &tracker, FrameContext &ctx, const Parameters &params, Profiler *profiler){
+	StageTimer timer(profiler);
+
+	//Mean colors of the objects, computed once for the frame
+	Mat colorMask;
+	if(params.colorMask && detectionLevel > 0)
+		resize(ctx.mask, colorMask, ctx.frame.size(), 0, 0, INTER_NEAREST);
+	else if(params.colorMask)
+		colorMask = ctx.mask;
+	ctx.features.reset(ctx.frame, colorMask);
+	ctx.features.meanColors(ctx.recs, ctx.colors);
+	timer.lap("track_features");
+
+	//Updates tracks with possible matches and removes the object associated to the tracks
+	if(params.assignment.compare("global") == 0)
+		tracker.assignTracks(ctx, frameDiagonal, params.distanceTH, params.avgColorTH);
+	else
+		tracker.updateTracks(ctx, frameDiagonal, params.distanceTH, params.avgColorTH);
+	timer.lap("track_update");
+
+	//Create new tracks with the unassigned objects
+	tracker.createNewTracks(ctx);
+	timer.lap("track_create");
+
+	//Classify tracks not yet classified, unless the scheduler is catching up with a live stream
+	if(ctx.work == FULL_ANALYSIS){
+		tracker.classifyTracks(service, params.probTH, params.reclassifyBudget);
+		timer.lap("track_classify");
+	}
+
+	//Remove useless tracks. When tracks are classified again, they live until they leave the scene instead of being restarted
+	tracker.deleteUselessTracks(params.noUpdateTH, params.lifetimeTH, params.reclassifyBudget == 0);
+	timer.lap("track_delete");
+
+	//Draw all the assigned tracks
+	tracker.drawTracks(ctx.overlay, params.probTH);
+	timer.lap("track_draw");
+
+}
+
+/* Classify and draw the objects found in the frame, depending on the selected modes */
+void analyzeObjects(ClassificationService &service, Tracker &tracker, FrameContext &ctx, const Parameters &params, Profiler *profiler){
+	//No objects were searched in the frame: only the tracks are shown where they were last seen.
+	//They are not updated, so that they survive a global change of the scene without being classified again
+	if(ctx.work == NO_DETECTION || ctx.globalChange){
+		if(params.classification && params.tracking)
+			tracker.drawTracks(ctx.overlay, params.probTH);
+		return;
+	}
+
+	//Classify and draw only if the number of objects found is less than a given threshold
+	//Avoid to perform operations when, because of background changes, the subtractor finds a lot of moving objects
+	if(ctx.objects <= params.maxObjs){
+		//Classification mode on
+		if(params.classification){
+			//Tracking mode on
+			if(params.tracking){
+				classifyObjectsWithTracking(service, tracker, ctx, params, profiler);
+			}
+			else if(ctx.work == FULL_ANALYSIS){//Tracking mode off
+				classifyObjects(service, ctx, params.probTH, profiler);
+			}
+			else{//Classification skipped by the scheduler
+				drawObjects(ctx);
+			}
+		}
+		else{//Classification mode off
+			//Draw only the rectangles without classification
+			drawObjects(ctx);
+		}
+	}
+	else
+		metrics.count(FRAMES_OVER_MAX_OBJECTS);
+}
+
+/* Show the frame and return the input from the keyboard */
+int showFrame(Mat frame){
+	//Create a window to show the video
+	namedWindow("Real time classification", WINDOW_AUTOSIZE);
+	moveWindow("Real time classification", 100, 50);
+	imshow("Real time classification", frame);
+
+	//Acquire input from the keyboard
+	return waitKey(1);
+}
+
+/* Decode stage: read and resize the frames of the stream, and plan the work to do on them */
+static void decodeStage(VideoCapture &input, FrameGrabber *grabber, FrameReplay *replay, FrameScheduler &scheduler, const Parameters &params, BoundedQueue<FramePtr> &out){
+	FramePool pool(3 * params.queueSize + FRAME_POOL_BUFFERS);	//Enough buffers for the frames queued between the stages
+	long index = 0;
+
+	while(true){
+		FramePtr ctx(new FrameContext());
+		ctx->index = index++;
+		if(!readFrame(input, grabber, replay, pool, *ctx, !isCameraSource(params.videoPath)))
+			break;
+		ctx->work = scheduler.plan();
+		if(!out.push(std::move(ctx)))
+			break;
+	}
+	out.close();
+}
+
+/* Foreground stage: background subtraction and objects detection */
+static void foregroundStage(Ptr<BackgroundSubtractor> subtractor, ForegroundFilter &filter, ChangeGate &gate, const RegionOfInterest &roi, BoundedQueue<FramePtr> &in, BoundedQueue<FramePtr> &out){
+	BlobDetector detector;
+	FramePtr ctx;
+
+	while(in.pop(ctx)){
+		if(ctx->work != NO_DETECTION){
+			extractForeground(subtractor, filter, gate, *ctx, roi);
+			detectObjects(detector, *ctx, roi);
+		}
+		if(!out.push(std::move(ctx)))
+			break;
+	}
+	//Stop the previous stage too, in case this one was interrupted
+	in.close();
+	out.close();
+}
+
+/* Classification stage: classification, tracking and drawing of the objects */
+static void classificationStage(ClassificationService &service, const Parameters &params, BoundedQueue<FramePtr> &in, BoundedQueue<FramePtr> &out){
+	Tracker tracker = createTracker(params);
+	FramePtr ctx;
+
+	while(in.pop(ctx)){
+		analyzeObjects(service, tracker, *ctx, params);
+		if(!out.push(std::move(ctx)))
+			break;
+	}
+	in.close();
+	out.close();
+}
+
+/* Analyze the stream running each stage on its own thread. Stages are connected by bounded queues,
+ * so a slow stage makes the previous ones wait instead of piling up frames. Each stage is served by
+ * a single thread, therefore frames are rendered in the same order they are read.
+ * A live stream is read through its capture thread, and the scheduler plans the work on each frame */
+void runPipeline(ClassificationService &service, VideoCapture &input, FrameGrabber *grabber, FrameReplay *replay, FrameScheduler &scheduler, Ptr<BackgroundSubtractor> subtractor, const RegionOfInterest &roi, const Parameters &params){
+	BoundedQueue<FramePtr> decoded(params.queueSize);		//Frames read and resized
+	BoundedQueue<FramePtr> detected(params.queueSize);		//Frames with the objects found
+	BoundedQueue<FramePtr> analyzed(params.queueSize);		//Frames ready to be shown
+	const string depthHelp = "Frames waiting between two stages of the analysis";			//Depth of the queues, read by the metrics
+	MetricProbe decodedProbe("tm_queue_depth", metricLabel("queue", "decoded"), depthHelp, false, [&]{ return (double) decoded.size(); });
+	MetricProbe detectedProbe("tm_queue_depth", metricLabel("queue", "detected"), depthHelp, false, [&]{ return (double) detected.size(); });
+	MetricProbe analyzedProbe("tm_queue_depth", metricLabel("queue", "analyzed"), depthHelp, false, [&]{ return (double) analyzed.size(); });
+	ForegroundFilter filter = createForegroundFilter(params);	//Blur and morphology of the foreground stage
+	ChangeGate gate = createChangeGate(params);				//Global changes of the scene, seen by the foreground stage
+	FramePtr ctx;
+	int keyboard = 0; 										//Input from keyboard
+
+	std::thread decoder(decodeStage, std::ref(input), grabber, replay, std::ref(scheduler), std::cref(params), std::ref(decoded));
+	std::thread foreground(foregroundStage, subtractor, std::ref(filter), std::ref(gate), std::cref(roi), std::ref(decoded), std::ref(detected));
+	std::thread classification(classificationStage, std::ref(service), std::cref(params), std::ref(detected), std::ref(analyzed));
+
+	//Render stage, the window has to be managed by the main thread
+	//Read until ESC, q is pressed
+	while(((char) keyboard != 'q' && (char) keyboard != 27) && analyzed.pop(ctx)){
+		keyboard = showFrame(ctx->overlay);
+		scheduler.done(*ctx);
+	}
+
+	//Stop all the stages, the capture first: the decode stage may be waiting for a frame
+	if(grabber)
+		grabber->stop();
+	analyzed.close();
+	classification.join();
+	foreground.join();
+	decoder.join();
+}
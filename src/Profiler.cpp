@@ -0,0 +1,56 @@
+
+#include "../include/Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+/* Record a measure of the stage */
+void Profiler::add(const std::string &stage, double ms){
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::map<std::string, std::vector<double> >::iterator it = samples_.find(stage);
+	if(it == samples_.end()){
+		order_.push_back(stage);
+		it = samples_.insert(std::make_pair(stage, std::vector<double>())).first;
+	}
+	it->second.push_back(ms);
+}
+
+/* Nearest-rank percentile of a sorted vector, p in [0, 100] */
+double Profiler::percentile(const std::vector<double> &sorted, double p){
+	if(sorted.empty())
+		return 0;
+	size_t rank = (size_t) std::ceil(p / 100.0 * sorted.size());
+	if(rank < 1)
+		rank = 1;
+	return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+/* Latency statistics of all the stages measured so far */
+std::vector<StageStats> Profiler::summary(){
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<StageStats> result;
+
+	for(size_t i = 0; i < order_.size(); i++){
+		std::vector<double> sorted = samples_[order_[i]];
+		std::sort(sorted.begin(), sorted.end());
+
+		StageStats stats;
+		stats.name = order_[i];
+		stats.samples = sorted.size();
+		stats.mean = 0;
+		for(size_t j = 0; j < sorted.size(); j++)
+			stats.mean += sorted[j];
+		stats.mean /= sorted.size();
+		stats.p50 = percentile(sorted, 50);
+		stats.p95 = percentile(sorted, 95);
+		stats.p99 = percentile(sorted, 99);
+		result.push_back(stats);
+	}
+	return result;
+}
+
+/* Discard all the measures */
+void Profiler::clear(){
+	std::lock_guard<std::mutex> lock(mutex_);
+	order_.clear();
+	samples_.clear();
+}
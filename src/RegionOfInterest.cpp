@@ -0,0 +1,72 @@
+#include "../include/RegionOfInterest.hpp"
+#include <sstream>
+
+using namespace cv;
+
+/* Parse a polygon, with the stream it applies to (-1 for every stream). Return false if the polygon is malformed */
+bool RegionOfInterest::parse(const std::string &spec, int &stream, std::vector<Point2f> &polygon){
+	std::string points = spec;
+	size_t colon = spec.find(':');
+
+	stream = -1;
+	polygon.clear();
+	if(colon != std::string::npos){
+		std::istringstream prefix(spec.substr(0, colon));
+		if(!(prefix >> stream) || stream < 0 || !(prefix >> std::ws).eof())
+			return false;
+		points = spec.substr(colon + 1);
+	}
+
+	std::istringstream in(points);
+	std::string vertex;
+	while(in >> vertex){
+		std::istringstream coordinates(vertex);
+		Point2f point;
+		char comma;
+		if(!(coordinates >> point.x >> comma >> point.y) || comma != ',' || !coordinates.eof())
+			return false;
+		if(point.x < 0 || point.x > 1 || point.y < 0 || point.y > 1)
+			return false;
+		polygon.push_back(point);
+	}
+	return polygon.size() >= 3;
+}
+
+/* Build the region of a stream from the polygons of the configuration file */
+void RegionOfInterest::build(const std::vector<std::string> &specs, int stream, Size frameSize){
+	polygons_.clear();
+	for(unsigned int i = 0; i < specs.size(); i++){
+		std::vector<Point2f> polygon;
+		int polygonStream;
+		if(!parse(specs[i], polygonStream, polygon) || (polygonStream >= 0 && polygonStream != stream))
+			continue;
+
+		std::vector<Point> vertices;
+		for(unsigned int k = 0; k < polygon.size(); k++)
+			vertices.push_back(Point(cvRound(polygon[k].x * (frameSize.width - 1)), cvRound(polygon[k].y * (frameSize.height - 1))));
+		polygons_.push_back(vertices);
+	}
+
+	if(polygons_.empty()){
+		bounds_ = Rect(Point(0, 0), frameSize);
+		mask_.release();
+		return;
+	}
+
+	bounds_ = boundingRect(polygons_[0]);
+	for(unsigned int i = 1; i < polygons_.size(); i++)
+		bounds_ |= boundingRect(polygons_[i]);
+	bounds_ &= Rect(Point(0, 0), frameSize);
+
+	mask_ = Mat::zeros(bounds_.size(), CV_8U);
+	fillPoly(mask_, polygons_, Scalar(255), LINE_8, 0, Point(-bounds_.x, -bounds_.y));
+}
+
+/* Check if a point of the frame is inside the polygons */
+bool RegionOfInterest::contains(Point point) const{
+	if(polygons_.empty())
+		return true;
+	if(!bounds_.contains(point))
+		return false;
+	return mask_.at<uchar>(point - bounds_.tl()) != 0;
+}
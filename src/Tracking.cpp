@@ -1,198 +1,418 @@
 #include "../include/Tracking.hpp"
 
-vector<Track> Track::tracks;	//vector containing all the tracks
-
-/* Class constructor */
-Track::Track(float x, float y, Rect rec, Mat bndBox){
-	//variable initialization
-	this->x = x;
-	this->y = y;
-	this->avgColor = mean(bndBox);
-	this->rec = rec;
-	this->bndBox = bndBox;
-	this->label = "";
-	this->prob = 0;
-	this->assigned = true;
-	this->framesWithoutUpdate = 0;
-	this->lifeTime = 1;
-}
-
-/* Update a track */
-void Track::updateTrack(float x, float y, Rect rec, Mat bndBox){
-	this->x = x;
-	this->y = y;
-	this->rec = rec;
-	this->bndBox = bndBox;
-	this->avgColor = mean(bndBox);
-}
-
-/* State that the track was not updated in this frame */
-void Track::noUpdateThisFrame(){
-	this->assigned = false;
-	this->framesWithoutUpdate++;
-	this->lifeTime++;
-}
-
-/* State that the track was updated in this frame */
-void Track::gotUpdate(){
-	this->assigned = true;
-	this->framesWithoutUpdate = 0;
-	this->lifeTime++;
-}
-
-/* Compare the track object with another object based on the average color */
-bool Track::checkMeanColor(Mat bndBox, float avgColorTH){
-	Scalar meanColor = mean(bndBox);
-	float distance;
+/* Replace an element of a column with the last one */
+template <typename T>
+static void swapRemove(vector<T> &column, int index){
+	if(index != (int)column.size() - 1)
+		column[index] = std::move(column.back());
+	column.pop_back();
+}
 
-	//Compute euclidean distance between the two mean color
-	distance = norm(this->avgColor, meanColor);
+/* Add a track and return its identifier. Slots left free by deleted tracks are reused, with a new generation */
+TrackId Tracker::addTrack(Point2f position, Rect rec, Mat bndBox, Vec3f color){
+	unsigned int slot;
+	if(freeSlots.empty()){
+		slot = slotIndex.size();
+		slotIndex.push_back(0);
+		slotGeneration.push_back(0);
+	}
+	else{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	slotIndex[slot] = ids.size();
 
-	//Bound distance between 0 and 1 (441.673 is the max distance in case of BGR color-space)
-	distance = distance / 441.673;
+	TrackId id = ((TrackId)slotGeneration[slot] << 32) | slot;
+	positions.push_back(position);
+	velocities.push_back(Point2f(0, 0));
+	covariances.push_back(Vec3f(KALMAN_MEASUREMENT_NOISE * KALMAN_MEASUREMENT_NOISE, 0, KALMAN_INITIAL_SPEED * KALMAN_INITIAL_SPEED));
+	colors.push_back(color);
+	rects.push_back(rec);
+	assigned.push_back(true);
+	framesWithoutUpdate.push_back(0);
+	lifeTimes.push_back(1);
+	classIds.push_back(-1);
+	probs.push_back(0);
+	confident.push_back(false);
+	crops.push_back(bndBox);
+	votes.push_back(ClassVotes());
+	classifications.push_back(0);
+	framesSinceSubmitted.push_back(0);
+	pending.push_back(PendingPrediction());
+	ids.push_back(id);
+	return id;
+}
 
-	if(distance <= avgColorTH){
-		return true;
-	}
+/* Position of a track in the columns, or -1 if the track has been deleted */
+int Tracker::indexOf(TrackId id) const{
+	unsigned int slot = id & 0xFFFFFFFF;
+	if(slot >= slotIndex.size() || slotGeneration[slot] != (unsigned int)(id >> 32))
+		return -1;
+	return slotIndex[slot];
+}
 
-	return false;
+/* Delete a track in constant time, moving the last track in its position */
+void Tracker::removeTrack(int index){
+	unsigned int slot = ids[index] & 0xFFFFFFFF;
+	slotGeneration[slot]++;
+	freeSlots.push_back(slot);
+
+	swapRemove(positions, index);
+	swapRemove(velocities, index);
+	swapRemove(covariances, index);
+	swapRemove(colors, index);
+	swapRemove(rects, index);
+	swapRemove(assigned, index);
+	swapRemove(framesWithoutUpdate, index);
+	swapRemove(lifeTimes, index);
+	swapRemove(classIds, index);
+	swapRemove(probs, index);
+	swapRemove(confident, index);
+	swapRemove(crops, index);
+	swapRemove(votes, index);
+	swapRemove(classifications, index);
+	swapRemove(framesSinceSubmitted, index);
+	swapRemove(pending, index);
+	swapRemove(ids, index);
+
+	//The moved track has a new position
+	if(index < (int)ids.size())
+		slotIndex[ids[index] & 0xFFFFFFFF] = index;
 }
 
-/* Find the index of the minimum element in a vector */
-int Track::findIndexMinElement(double v [], int size){
-	int minIndex = size - 1;
-	double min = 1;
-	for(int i = 0; i < size; i++){
-		if (v[i] < min){
-			min = v[i];
-			minIndex = i;
-		}
+/* Start a new frame: every track gets older and it is unassigned until an object is assigned to it.
+ * With the motion model, the position of each track is predicted for the new frame */
+void Tracker::ageTracks(){
+	int tracksSize = ids.size();
+	for(int i = 0; i < tracksSize; i++){
+		assigned[i] = false;
+		framesWithoutUpdate[i]++;
+		lifeTimes[i]++;
+		framesSinceSubmitted[i]++;
+		if(motionModel)
+			predictTrack(i);
 	}
-	return minIndex;
 }
 
-/* Compute the center of mass of a vector of points */
-Point2f Track::computeMassCenter(vector<Point> contours){
-	Moments mu;
-	Point2f mc;
+/* Prediction step of the filter: the track moves by its velocity, and the uncertainty grows with the time passed
+ * and with the acceleration the object may have had (constant over the frame) */
+void Tracker::predictTrack(int index){
+	const float q = KALMAN_ACCELERATION_NOISE * KALMAN_ACCELERATION_NOISE;
+	Vec3f &p = covariances[index];
+
+	positions[index] += velocities[index];
+	p = Vec3f(p[0] + 2 * p[1] + p[2] + q / 4, p[1] + p[2] + q / 2, p[2] + q);
+}
+
+/* Distance (as a fraction of the frame diagonal) within which an object can be assigned to the track: distanceTH
+ * without the motion model, otherwise KALMAN_GATE_SIGMAS standard deviations of the innovation of the position,
+ * from distanceTH up to KALMAN_MAX_GATE times it */
+float Tracker::gateOf(int index, float distanceTH) const{
+	if(!motionModel)
+		return distanceTH;
+	float innovation = sqrt(covariances[index][0] + KALMAN_MEASUREMENT_NOISE * KALMAN_MEASUREMENT_NOISE);
+	return std::min(std::max(KALMAN_GATE_SIGMAS * innovation, distanceTH), KALMAN_MAX_GATE * distanceTH);
+}
+
+/* Assign an object to a track. With the motion model, the position of the object corrects the predicted position and
+ * the velocity of the track (update step of the filter) */
+void Tracker::updateTrack(int index, Point2f position, Rect rec, Mat bndBox, Vec3f color){
+	if(motionModel){
+		Vec3f &p = covariances[index];
+		float innovation = p[0] + KALMAN_MEASUREMENT_NOISE * KALMAN_MEASUREMENT_NOISE;
+		float gainPosition = p[0] / innovation, gainVelocity = p[1] / innovation;
+		Point2f residual = position - positions[index];
 
-	//Get the moment
-	mu = moments( contours, false );
+		positions[index] += gainPosition * residual;
+		velocities[index] += gainVelocity * residual;
+		p = Vec3f((1 - gainPosition) * p[0], (1 - gainPosition) * p[1], p[2] - gainVelocity * p[1]);
+	}
+	else
+		positions[index] = position;
+	rects[index] = rec;
+	colors[index] = color;
+	//The image is needed only until the track is confident
+	if(!confident[index])
+		crops[index] = bndBox;
+	assigned[index] = true;
+	framesWithoutUpdate[index] = 0;
+}
 
-	//Get mass center
-	mc = Point2f(mu.m10/mu.m00 , mu.m01/mu.m00);
+/* Compute the distance between the average color of the track and another average color */
+float Tracker::computeColorDistance(int index, Vec3f meanColor) const{
+	//Compute euclidean distance between the two mean color
+	float distance = norm(colors[index] - meanColor);
 
-	return mc;//mc.x, mc.y
+	//Bound distance between 0 and 1 (441.673 is the max distance in case of BGR color-space)
+	return distance / 441.673;
 }
 
 /* Compute the euclidean distance between the track object and another object
  * Note that distances are independent from the frame size as long as the aspect ratio is 16:9 */
-float Track::computeDistanceBetweenObjects(Point2f point, float frameDiagonal){
-	float distance = sqrt( pow(this->x - point.x, 2) + pow(this->y - point.y, 2));
+float Tracker::computeDistanceBetweenObjects(int index, Point2f point, float frameDiagonal) const{
+	Point2f delta = positions[index] - point;
+	float distance = sqrt(delta.x * delta.x + delta.y * delta.y);
 
 	//Bound the distance between 0 and 1
 	return distance/frameDiagonal;
 }
 
-/* Try to assign an object to the track based on the centers of mass distance */
-bool Track::massCenterAssignment(float frameDiagonal, float distanceTH, float avgColorTH){
-	int bndBoxesSize = boundingBoxes.size();
-	double euclideanDistance[bndBoxesSize]; //Contains the computed distances
+/* Try to assign an object to the track based on the centers of mass distance, from the predicted position with the motion model */
+bool Tracker::massCenterAssignment(int index, FrameContext &ctx, float frameDiagonal, float distanceTH, float avgColorTH){
+	int bndBoxesSize = ctx.boundingBoxes.size();
+	int indexMassCenterMin = -1;
+	double minDistance = 1;
 
-	//Compute all the distances between the track and all others objects
+	//Find the nearest object
 	for(int i = 0; i < bndBoxesSize; i++){
-		euclideanDistance[i] = computeDistanceBetweenObjects(massCenters.at(i), frameDiagonal);
+		double distance = computeDistanceBetweenObjects(index, ctx.massCenters[i], frameDiagonal);
+		if(distance < minDistance){
+			minDistance = distance;
+			indexMassCenterMin = i;
+		}
 	}
 
-	//Find the index of the minimum distance in the vector
-	int indexMassCenterMin = findIndexMinElement(euclideanDistance, bndBoxesSize);
-
 	//Check if the distance is under the specified threshold and do the same for the mean color
-	if(indexMassCenterMin >= 0 && euclideanDistance[indexMassCenterMin] <= distanceTH && checkMeanColor(boundingBoxes.at(indexMassCenterMin), avgColorTH)){
+	if(indexMassCenterMin >= 0 && minDistance <= gateOf(index, distanceTH) && computeColorDistance(index, ctx.colors[indexMassCenterMin]) <= avgColorTH){
 		//Object assigned to the track
-		updateTrack(massCenters.at(indexMassCenterMin).x, massCenters.at(indexMassCenterMin).y , recs.at(indexMassCenterMin), boundingBoxes.at(indexMassCenterMin));
-		gotUpdate();
-		boundingBoxes.erase(boundingBoxes.begin() + indexMassCenterMin);
-		recs.erase(recs.begin() + indexMassCenterMin);
-		massCenters.erase(massCenters.begin() + indexMassCenterMin);
+		updateTrack(index, ctx.massCenters[indexMassCenterMin], ctx.recs[indexMassCenterMin], ctx.boundingBoxes[indexMassCenterMin], ctx.colors[indexMassCenterMin]);
+		ctx.boundingBoxes.erase(ctx.boundingBoxes.begin() + indexMassCenterMin);
+		ctx.recs.erase(ctx.recs.begin() + indexMassCenterMin);
+		ctx.massCenters.erase(ctx.massCenters.begin() + indexMassCenterMin);
+		ctx.colors.erase(ctx.colors.begin() + indexMassCenterMin);
 		return true;
-	}else{
-		//Object not assigned to the track
-		noUpdateThisFrame();
 	}
 	return false;
 }
 
 /* Update all the tracks trying to assign each of the to an object */
-void Track::updateTracks(float frameDiagonal, float distanceTH, float avgColorTH){
-	int tracksSize = tracks.size();
+void Tracker::updateTracks(FrameContext &ctx, float frameDiagonal, float distanceTH, float avgColorTH){
+	int tracksSize = ids.size();
+	ageTracks();
 	for(int i = 0; i < tracksSize; i++){
-		tracks.at(i).massCenterAssignment(frameDiagonal, distanceTH, avgColorTH);
+		massCenterAssignment(i, ctx, frameDiagonal, distanceTH, avgColorTH);
+	}
+}
+
+/* Assign the objects to the tracks minimizing the total cost, instead of letting each track take the nearest object in turn.
+ * Only pairs within the distance and the average color thresholds are candidates, and the candidates of a track are searched
+ * through a uniform grid over the frame. With the motion model the distance is measured from the predicted position
+ * and the threshold is the gate of each track. Tracks and objects linked by candidate pairs form independent groups,
+ * each one solved on its own with the Hungarian algorithm. The assigned objects are removed from the frame context */
+void Tracker::assignTracks(FrameContext &ctx, float frameDiagonal, float distanceTH, float avgColorTH){
+	int numTracks = ids.size();
+	int numObjects = ctx.massCenters.size();
+	vector<int> 	candidates;					//Objects close to a track
+	vector<int> 	parent(numTracks + numObjects);	//Union-find of tracks (first) and objects (then)
+	vector<int> 	match(numTracks, -1);		//Object assigned to each track
+
+	struct Pair { int track, object; double cost; int group; };
+	vector<Pair> pairs;
+
+	for(unsigned int i = 0; i < parent.size(); i++)
+		parent[i] = i;
+	std::function<int(int)> find = [&](int n){ while(parent[n] != n) n = parent[n] = parent[parent[n]]; return n; };
+
+	//Positions of the tracks in this frame, and their gates
+	ageTracks();
+	vector<float> gates(numTracks);
+	float maxGate = distanceTH;
+	for(int t = 0; t < numTracks; t++){
+		gates[t] = gateOf(t, distanceTH);
+		maxGate = std::max(maxGate, gates[t]);
+	}
+
+	//Candidate pairs: cells as large as the largest gate, so that the candidates lie in the 3x3 cells around a track
+	grid.build(ctx.massCenters, ctx.frame.size(), maxGate * frameDiagonal);
+	for(int t = 0; t < numTracks; t++){
+		candidates.clear();
+		grid.query(positions[t], candidates);
+		for(unsigned int k = 0; k < candidates.size(); k++){
+			int o = candidates[k];
+			float distance = computeDistanceBetweenObjects(t, ctx.massCenters[o], frameDiagonal);
+			if(distance > gates[t])
+				continue;
+			float colorDistance = computeColorDistance(t, ctx.colors[o]);
+			if(colorDistance > avgColorTH)
+				continue;
+
+			//Both terms are bounded between 0 and 1 by their thresholds
+			Pair pair = { t, o, distance / std::max(gates[t], 1e-6f) + colorDistance / std::max(avgColorTH, 1e-6f), 0 };
+			pairs.push_back(pair);
+			parent[find(t)] = find(numTracks + o);
+		}
+	}
+
+	//Solve each group of linked tracks and objects
+	for(unsigned int k = 0; k < pairs.size(); k++)
+		pairs[k].group = find(pairs[k].track);
+	std::sort(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b){ return a.group < b.group; });
+
+	vector<int> localTrack(numTracks, -1), localObject(numObjects, -1);
+	vector<int> groupTracks, groupObjects;
+	for(unsigned int start = 0, end; start < pairs.size(); start = end){
+		groupTracks.clear();
+		groupObjects.clear();
+		for(end = start; end < pairs.size() && pairs[end].group == pairs[start].group; end++){
+			if(localTrack[pairs[end].track] < 0){
+				localTrack[pairs[end].track] = groupTracks.size();
+				groupTracks.push_back(pairs[end].track);
+			}
+			if(localObject[pairs[end].object] < 0){
+				localObject[pairs[end].object] = groupObjects.size();
+				groupObjects.push_back(pairs[end].object);
+			}
+		}
+
+		vector<double> cost(groupTracks.size() * groupObjects.size(), INFEASIBLE_COST);
+		for(unsigned int k = start; k < end; k++)
+			cost[localTrack[pairs[k].track] * groupObjects.size() + localObject[pairs[k].object]] = pairs[k].cost;
+
+		vector<int> assignment = solveAssignment(cost, groupTracks.size(), groupObjects.size());
+		for(unsigned int k = 0; k < groupTracks.size(); k++)
+			if(assignment[k] >= 0)
+				match[groupTracks[k]] = groupObjects[assignment[k]];
+
+		for(unsigned int k = 0; k < groupTracks.size(); k++)
+			localTrack[groupTracks[k]] = -1;
+		for(unsigned int k = 0; k < groupObjects.size(); k++)
+			localObject[groupObjects[k]] = -1;
+	}
+
+	//Update the tracks and keep only the objects not assigned
+	vector<char> objectAssigned(numObjects, 0);
+	for(int t = 0; t < numTracks; t++){
+		if(match[t] >= 0){
+			int o = match[t];
+			updateTrack(t, ctx.massCenters[o], ctx.recs[o], ctx.boundingBoxes[o], ctx.colors[o]);
+			objectAssigned[o] = 1;
+		}
 	}
+	int kept = 0;
+	for(int o = 0; o < numObjects; o++){
+		if(objectAssigned[o])
+			continue;
+		ctx.massCenters[kept] = ctx.massCenters[o];
+		ctx.recs[kept] = ctx.recs[o];
+		ctx.boundingBoxes[kept] = ctx.boundingBoxes[o];
+		ctx.colors[kept] = ctx.colors[o];
+		kept++;
+	}
+	ctx.massCenters.resize(kept);
+	ctx.recs.resize(kept);
+	ctx.boundingBoxes.resize(kept);
+	ctx.colors.resize(kept);
 }
 
 /* Create new tracks from the not assigned objects */
-void Track::createNewTracks(){
-	int bndBoxSize = boundingBoxes.size(); //massCenters, recs and boundingBoxes have the same size and they have the informations about an object in the same position
+void Tracker::createNewTracks(FrameContext &ctx){
+	int bndBoxSize = ctx.boundingBoxes.size(); //massCenters, recs and boundingBoxes have the same size and they have the informations about an object in the same position
 	for(int i = 0; i < bndBoxSize; i++){
-		Track newTrack = Track(massCenters.at(i).x,massCenters.at(i).y, recs.at(i), boundingBoxes.at(i));
-		tracks.push_back(newTrack);
+		addTrack(ctx.massCenters[i], ctx.recs[i], ctx.boundingBoxes[i], ctx.colors[i]);
+	}
+	liveTracks.set(ids.size());
+}
+
+/* Fuse a prediction with the previous ones of the track: the probability of the predicted class is added to its votes,
+ * the class with the most votes is the label and its votes over the classifications are the confidence. A prediction
+ * that disagrees with the previous ones lowers the confidence, so tracks with an unstable history are classified again */
+void Tracker::addPrediction(int index, const Prediction &prediction, float probTH, int budget){
+	votes[index][strToEnum(prediction.first)] += prediction.second;
+	classifications[index]++;
+
+	int best = 0;
+	for(int c = 1; c <= other; c++)
+		if(votes[index][c] > votes[index][best])
+			best = c;
+	classIds[index] = best;
+	probs[index] 	= votes[index][best] / classifications[index];
+
+	//Without a budget every track is classified once
+	if(budget <= 0 || probs[index] >= probTH){
+		confident[index] = true;
+		crops[index] 	 = Mat();
 	}
 }
 
-/* Classify the tracks not yet classified */
-void Track::classifyTracks(Classifier classifier, int classes){
-	vector<Track *> toClassify; //Vector of pointers to track objects to classify
-	vector<Mat> 	batch; 		//Batch of objects to classify
+/* Classify the tracks that need it. Their objects are submitted to the classification service,
+ * and each track gets its label as soon as its prediction is available, without waiting for it.
+ * With a budget, at most budget objects are submitted per frame: first the tracks never classified, then the least
+ * confident ones seen in this frame, each one at most every RECLASSIFY_INTERVAL frames. Confident tracks are never
+ * classified again. Without a budget, every track is classified once */
+void Tracker::classifyTracks(ClassificationService &service, float probTH, int budget){
+	vector<int> toClassify; //Positions of the tracks to classify
+	vector<Mat> batch; 		//Batch of objects to classify
+	int tracksSize = ids.size();
 
 	//Search for track to classify
-	for(int i = 0; i < (int)tracks.size(); i++){
-		if(tracks.at(i).label.compare("") == 0){
-			toClassify.push_back(&tracks.at(i));
-			batch.push_back(tracks.at(i).bndBox);
-		}
+	for(int i = 0; i < tracksSize; i++){
+		if(confident[i] || pending[i].valid())
+			continue;
+		if(classifications[i] == 0 || (budget > 0 && assigned[i] && framesSinceSubmitted[i] >= RECLASSIFY_INTERVAL))
+			toClassify.push_back(i);
+	}
+	if(budget > 0 && (int)toClassify.size() > budget){
+		std::partial_sort(toClassify.begin(), toClassify.begin() + budget, toClassify.end(), [this](int a, int b){
+			if((classifications[a] == 0) != (classifications[b] == 0))
+				return classifications[a] == 0;
+			return probs[a] < probs[b];
+		});
+		toClassify.resize(budget);
 	}
 
 	//If there are objects to classify
-	if(batch.size() > 0){
-		//set batch size on-fly and classify
-		classifier.setBatchSize(batch.size());
-		predictions = classifier.ClassifyBatch(batch, classes, 1);
+	if(toClassify.size() > 0){
+		for(unsigned int i = 0; i < toClassify.size(); i++){
+			batch.push_back(crops[toClassify[i]]);
+			framesSinceSubmitted[toClassify[i]] = 0;
+		}
+		vector<PendingPrediction> results = service.submitBatch(batch);
+		for(unsigned int i = 0; i < toClassify.size(); i++)
+			pending[toClassify[i]] = results[i];
+		submitted += toClassify.size();
 	}
 
-	//Update the relative tracks
-	for(int i = 0; i < (int)predictions.size(); i++){
-		toClassify.at(i)->label = predictions.at(i).at(0).first;
-		toClassify.at(i)->prob  = predictions.at(i).at(0).second;
+	//Update the tracks whose prediction is ready
+	for(int i = 0; i < tracksSize; i++){
+		if(pending[i].valid() && pending[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+			addPrediction(i, pending[i].get().at(0), probTH, budget);
+			pending[i] 	= PendingPrediction();
+		}
 	}
 }
 
-/* Delete either the tracks not updated for a certain period or too old */
-void Track::deleteUselessTracks(int noUpdateTH, int lifetimeTH){
-	for(unsigned int i = 0; i < tracks.size(); i++){
-		if(tracks.at(i).framesWithoutUpdate > noUpdateTH || tracks.at(i).lifeTime > lifetimeTH){
-			tracks.erase(tracks.begin() + i);
-			i--;
+/* Delete the tracks not updated for a certain period and, if restartOld, the ones too old, which are created again and
+ * classified from scratch. Otherwise tracks live until their object leaves the scene, and keep fusing their predictions.
+ * Scanning backwards, the track moved in place of a deleted one has already been checked */
+void Tracker::deleteUselessTracks(int noUpdateTH, int lifetimeTH, bool restartOld){
+	for(int i = ids.size() - 1; i >= 0; i--){
+		if(framesWithoutUpdate[i] > noUpdateTH){
+			departed++;
+			removeTrack(i);
+		}
+		else if(restartOld && lifeTimes[i] > lifetimeTH){
+			removeTrack(i);
 		}
 	}
+	liveTracks.set(ids.size());
 }
 
 /* Draw on the frame all the tracks assigned to an object*/
-void Track::drawTracks(Mat frame, float probTH){
+void Tracker::drawTracks(Mat frame, float probTH){
 	int baseline;
+	int tracksSize = ids.size();
 
-	for(unsigned int i = 0; i < tracks.size(); i++){
-		Track * auxTrack = &tracks.at(i);
+	for(int i = 0; i < tracksSize; i++){
 		//Avoid to print either unassigned tracks or tracks classified as "other" or not yet classified or classified with a too low probability
-		if(auxTrack->assigned && strToEnum(auxTrack->label) != background && auxTrack->prob >= probTH){
-			Size textSize = getTextSize(auxTrack->label, FONT_HERSHEY_PLAIN, 1.0, 1, &baseline);
+		if(assigned[i] && classIds[i] >= 0 && classIds[i] != background && probs[i] >= probTH){
+			String label = enumToStr((Classes)classIds[i]);
+			Size textSize = getTextSize(label, FONT_HERSHEY_PLAIN, 1.0, 1, &baseline);
 			//Draw the filled rectangle for the text
-			rectangle(frame, auxTrack->rec.tl() - Point(1, 1), auxTrack->rec.tl() + Point(textSize.width, -(textSize.height + 6)), recColors[strToEnum(auxTrack->label)], CV_FILLED);
+			rectangle(frame, rects[i].tl() - Point(1, 1), rects[i].tl() + Point(textSize.width, -(textSize.height + 6)), recColors[classIds[i]], CV_FILLED);
 			//Draw the classification and the relative probability
-			putText(frame, auxTrack->label, Point(auxTrack->rec.x, auxTrack->rec.y - 4), FONT_HERSHEY_PLAIN, 1.0, Scalar(0,0,0), 1);
+			putText(frame, label, Point(rects[i].x, rects[i].y - 4), FONT_HERSHEY_PLAIN, 1.0, Scalar(0,0,0), 1);
 			//Draw the rectangle
-			rectangle(frame, auxTrack->rec.br(), auxTrack->rec.tl(), recColors[strToEnum(auxTrack->label)], 2);
+			rectangle(frame, rects[i].br(), rects[i].tl(), recColors[classIds[i]], 2);
 		}
 	}
 }
-